@@ -0,0 +1,148 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "immutable_string/arena.hpp"
+#include "immutable_string/epoch.hpp"
+#include "immutable_string/refcount.hpp"
+#include "immutable_string/string.hpp"
+
+using namespace immutable_string;
+
+// Copies and destroys strings on 1 to hardware_concurrency() threads, for
+// every thread-safe reference counting policy and for std::shared_ptr:
+//   BM_copy_shared   all threads copy the same string, so every copy updates
+//                    the cache line holding its counter
+//   BM_copy_private  each thread copies a string of its own, so nothing is
+//                    shared between the threads
+//   BM_read_published
+//                    all threads read one published string under an epoch
+//                    guard, without copying it
+// The copy benchmarks report `copies`, the total rate, and
+// `copies_per_thread`; BM_read_published reports `reads` and
+// `reads_per_thread`. Without contention the per-thread rate stays flat as
+// threads are added; the gap between the shared and private runs at the same
+// number of threads is the cost of the contended cache line. Where Google Benchmark is built with libpfm, the
+// cache misses behind it are counted by
+//   --benchmark_perf_counters=CYCLES,INSTRUCTIONS,CACHE-MISSES
+namespace {
+
+// longer than the inline capacity, so that copies share a heap buffer
+const char text[] = "service.endpoint=https://config.example.com/v1";
+
+template <class RefCount>
+using counted_string =
+    basic_string<char, std::char_traits<char>, std::allocator<char>, RefCount>;
+
+template <class String>
+String make_string() {
+  return String(text, sizeof(text) - 1);
+}
+template <>
+std::shared_ptr<const std::string> make_string() {
+  return std::make_shared<const std::string>(text, sizeof(text) - 1);
+}
+
+// Makes the strings of a run. Uncounted strings are never freed one by one,
+// so they come from an arena released with the maker.
+template <class String>
+struct string_maker {
+  String make() { return make_string<String>(); }
+};
+template <>
+struct string_maker<arena_string> {
+  arena_string make() { return arena_string(text, sizeof(text) - 1, memory); }
+
+  arena memory;
+};
+
+// Made by the main thread before the threads start, so that a biased counter
+// is owned by the main thread, which also runs the first of them.
+template <class String>
+String shared;
+template <class String>
+std::unique_ptr<string_maker<String>> shared_maker;
+
+template <class String>
+void make_shared_string(const benchmark::State&) {
+  shared_maker<String>.reset(new string_maker<String>);
+  shared<String> = shared_maker<String>->make();
+}
+template <class String>
+void free_shared_string(const benchmark::State&) {
+  shared<String> = String();
+  shared_maker<String>.reset();
+}
+
+void set_rate(benchmark::State& state, const std::string& name) {
+  const auto count = static_cast<double>(state.iterations());
+  state.counters[name] = {count, benchmark::Counter::kIsRate};
+  state.counters[name + "_per_thread"] = {count,
+                                          benchmark::Counter::kAvgThreadsRate};
+}
+
+template <class String>
+void BM_copy_shared(benchmark::State& state) {
+  for (auto _ : state) {
+    String copy = shared<String>;
+    benchmark::DoNotOptimize(copy);
+  }
+  set_rate(state, "copies");
+}
+
+template <class String>
+void BM_copy_private(benchmark::State& state) {
+  string_maker<String> maker;
+  const auto str = maker.make();
+  for (auto _ : state) {
+    String copy = str;
+    benchmark::DoNotOptimize(copy);
+  }
+  set_rate(state, "copies");
+}
+
+std::unique_ptr<published<string>> config;
+
+void make_config(const benchmark::State&) {
+  config.reset(new published<string>(make_string<string>()));
+}
+void free_config(const benchmark::State&) {
+  config.reset();
+  epoch::collect();
+}
+
+void BM_read_published(benchmark::State& state) {
+  for (auto _ : state) {
+    epoch::guard guard;
+    benchmark::DoNotOptimize(config->load(guard).size());
+  }
+  set_rate(state, "reads");
+}
+
+void with_threads(benchmark::internal::Benchmark* b) {
+  const int threads = std::max(1u, std::thread::hardware_concurrency());
+  b->ThreadRange(1, threads)->UseRealTime();
+}
+
+}  // namespace
+
+#define BENCHMARK_COPIES(String)                                           \
+  BENCHMARK_TEMPLATE(BM_copy_shared, String)                               \
+      ->Setup(make_shared_string<String>)                                  \
+      ->Teardown(free_shared_string<String>)                               \
+      ->Apply(with_threads);                                               \
+  BENCHMARK_TEMPLATE(BM_copy_private, String)->Apply(with_threads)
+
+BENCHMARK_COPIES(counted_string<atomic_refcount>);
+BENCHMARK_COPIES(counted_string<biased_refcount>);
+BENCHMARK_COPIES(counted_string<deferred_refcount>);
+// no counting at all, the bound any policy approaches
+BENCHMARK_COPIES(arena_string);
+BENCHMARK_COPIES(std::shared_ptr<const std::string>);
+BENCHMARK(BM_read_published)
+    ->Setup(make_config)
+    ->Teardown(free_config)
+    ->Apply(with_threads);
@@ -0,0 +1,281 @@
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <new>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "immutable_string/searcher.hpp"
+#include "immutable_string/string.hpp"
+
+using immutable_string::searcher;
+using immutable_string::string;
+
+// Every benchmark runs for immutable_string::string and, as baselines,
+// std::string and std::string_view, over the sizes below: the first fits
+// inline, the last is larger than the L1 cache.
+//
+// The construction, copy, comparison and hash benchmarks also run over keys of
+// 7 to 22 characters for string and three_word_string, the layout string had
+// before it became one pointer wide. Such keys were stored inline then and
+// take a heap buffer now, so these runs measure what the narrower string
+// costs them. The hash runs favour string, which hashes a buffer only once.
+namespace {
+
+const std::int64_t sizes[] = {4, 16, 64, 256, 1024, 4096, 65536};
+
+void with_sizes(benchmark::internal::Benchmark* b) {
+  for (const auto size : sizes) b->Arg(size);
+}
+
+// Letters from 'a' to 'y', so that 'z' is never found.
+std::string make_text(std::size_t count) {
+  std::string text(count, ' ');
+  for (std::size_t i = 0; i < count; ++i) text[i] = 'a' + i % 25;
+  return text;
+}
+
+// Three words holding either a string of up to 22 characters inline, behind
+// a byte of (size << 1) | 1, or the size << 1 and a shared buffer.
+class three_word_string {
+ public:
+  three_word_string(const char* s, std::size_t count) {
+    if (count <= local_capacity) {
+      std::memset(m_local, 0, sizeof(m_local));
+      m_local[0] = static_cast<char>(count << 1 | 1);
+      std::memcpy(m_local + 1, s, count);
+      return;
+    }
+    std::shared_ptr<char[]> data(new char[count + 1]);
+    std::memcpy(data.get(), s, count);
+    data[count] = '\0';
+    new (&m_heap) heap_type{count << 1, std::move(data)};
+  }
+  three_word_string(const three_word_string& other) {
+    if (other._is_local()) {
+      std::memcpy(m_local, other.m_local, sizeof(m_local));
+    } else {
+      new (&m_heap) heap_type(other.m_heap);
+    }
+  }
+  three_word_string& operator=(const three_word_string&) = delete;
+  ~three_word_string() {
+    if (!_is_local()) m_heap.~heap_type();
+  }
+
+  const char* data() const noexcept {
+    return _is_local() ? m_local + 1 : m_heap.data.get();
+  }
+  std::size_t size() const noexcept {
+    return (_is_local() ? static_cast<unsigned char>(m_local[0])
+                        : m_heap.tagged_size) >>
+           1;
+  }
+  std::string_view view() const noexcept { return {data(), size()}; }
+
+  int compare(const three_word_string& other) const noexcept {
+    return view().compare(other.view());
+  }
+  friend bool operator==(const three_word_string& lhs,
+                         const three_word_string& rhs) noexcept {
+    return lhs.view() == rhs.view();
+  }
+
+ private:
+  struct heap_type {
+    std::size_t tagged_size;
+    std::shared_ptr<char[]> data;
+  };
+  static const std::size_t local_capacity = sizeof(heap_type) - 2;
+
+  bool _is_local() const noexcept { return m_local[0] & 1; }
+
+  union {
+    heap_type m_heap;
+    char m_local[sizeof(heap_type)];
+  };
+};
+
+const std::int64_t key_sizes[] = {7, 12, 17, 22};
+
+void with_key_sizes(benchmark::internal::Benchmark* b) {
+  for (const auto size : key_sizes) b->Arg(size);
+}
+
+std::size_t hash_of(const string& str) { return std::hash<string>{}(str); }
+std::size_t hash_of(const std::string& str) {
+  return std::hash<std::string>{}(str);
+}
+std::size_t hash_of(std::string_view str) {
+  return std::hash<std::string_view>{}(str);
+}
+std::size_t hash_of(const three_word_string& str) {
+  return std::hash<std::string_view>{}(str.view());
+}
+
+void set_bytes(benchmark::State& state) {
+  state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations()) *
+                          state.range(0));
+}
+
+template <class String>
+void BM_construct(benchmark::State& state) {
+  const auto text = make_text(state.range(0));
+  for (auto _ : state) {
+    String str(text.data(), text.size());
+    benchmark::DoNotOptimize(str);
+  }
+  set_bytes(state);
+}
+
+template <class String>
+void BM_copy(benchmark::State& state) {
+  const auto text = make_text(state.range(0));
+  const String str(text.data(), text.size());
+  for (auto _ : state) {
+    String copy = str;
+    benchmark::DoNotOptimize(copy);
+  }
+}
+
+template <class String>
+void BM_move(benchmark::State& state) {
+  const auto text = make_text(state.range(0));
+  String str(text.data(), text.size());
+  for (auto _ : state) {
+    String moved = std::move(str);
+    benchmark::DoNotOptimize(moved);
+    str = std::move(moved);
+  }
+}
+
+template <class String>
+void BM_find_char(benchmark::State& state) {
+  const auto text = make_text(state.range(0));
+  const String str(text.data(), text.size());
+  for (auto _ : state) benchmark::DoNotOptimize(str.find('z'));
+  set_bytes(state);
+}
+
+// a prefix of the needle recurs every 25 characters
+template <class String>
+void BM_find_short(benchmark::State& state) {
+  const auto text = make_text(state.range(0));
+  const String str(text.data(), text.size());
+  for (auto _ : state) benchmark::DoNotOptimize(str.find("abcdz", 0, 5));
+  set_bytes(state);
+}
+
+template <class String>
+void BM_find_long(benchmark::State& state) {
+  const auto text = make_text(state.range(0));
+  const String str(text.data(), text.size());
+  const auto needle = make_text(40) + 'z';
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(str.find(needle.data(), 0, needle.size()));
+  }
+  set_bytes(state);
+}
+
+// Text of one repeated letter and needles matching it but for one character
+// in their middle, so that every position matches the first and the last
+// character of the needle:
+//   BM_find_worst        a needle of 201 characters, past two_way_threshold,
+//                        which shares a prefix of 100 with every position
+//   BM_find_worst_short  a needle of 16 characters
+template <class String>
+void find_worst(benchmark::State& state, const std::string& needle) {
+  const std::string text(state.range(0), 'a');
+  const String str(text.data(), text.size());
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(str.find(needle.data(), 0, needle.size()));
+  }
+  set_bytes(state);
+}
+
+template <class String>
+void BM_find_worst(benchmark::State& state) {
+  find_worst<String>(state,
+                     std::string(100, 'a') + 'b' + std::string(100, 'a'));
+}
+
+template <class String>
+void BM_find_worst_short(benchmark::State& state) {
+  find_worst<String>(state, std::string(8, 'a') + 'b' + std::string(7, 'a'));
+}
+
+// The worst case of a searcher, which factorizes its needle once where
+// find() does so on every call that the vectorized filter gives up on.
+void BM_find_worst_searcher(benchmark::State& state) {
+  const std::string text(state.range(0), 'a');
+  const string str(text.data(), text.size());
+  const auto needle = std::string(100, 'a') + 'b' + std::string(100, 'a');
+  const searcher prepared{string(needle.data(), needle.size())};
+  for (auto _ : state) benchmark::DoNotOptimize(str.find(prepared));
+  set_bytes(state);
+}
+
+// Distinct buffers differing in the last character only.
+template <class String>
+void BM_compare(benchmark::State& state) {
+  auto text = make_text(state.range(0));
+  const String lhs(text.data(), text.size());
+  text.back() = 'z';
+  const String rhs(text.data(), text.size());
+  for (auto _ : state) benchmark::DoNotOptimize(lhs.compare(rhs));
+  set_bytes(state);
+}
+
+// Equal characters in distinct buffers.
+template <class String>
+void BM_equal(benchmark::State& state) {
+  const auto text = make_text(state.range(0));
+  const String lhs(text.data(), text.size());
+  const String rhs(text.data(), text.size());
+  for (auto _ : state) benchmark::DoNotOptimize(lhs == rhs);
+  set_bytes(state);
+}
+
+// immutable_string computes the hash of a heap string once per buffer
+template <class String>
+void BM_hash(benchmark::State& state) {
+  const auto text = make_text(state.range(0));
+  const String str(text.data(), text.size());
+  for (auto _ : state) benchmark::DoNotOptimize(hash_of(str));
+  set_bytes(state);
+}
+
+}  // namespace
+
+#define BENCHMARK_STRINGS(name)                                      \
+  BENCHMARK_TEMPLATE(name, string)->Apply(with_sizes);               \
+  BENCHMARK_TEMPLATE(name, std::string)->Apply(with_sizes);          \
+  BENCHMARK_TEMPLATE(name, std::string_view)->Apply(with_sizes)
+
+#define BENCHMARK_KEYS(name)                                          \
+  BENCHMARK_TEMPLATE(name, string)->Apply(with_key_sizes);            \
+  BENCHMARK_TEMPLATE(name, three_word_string)->Apply(with_key_sizes)
+
+BENCHMARK_STRINGS(BM_construct);
+BENCHMARK_STRINGS(BM_copy);
+BENCHMARK_STRINGS(BM_move);
+BENCHMARK_STRINGS(BM_find_char);
+BENCHMARK_STRINGS(BM_find_short);
+BENCHMARK_STRINGS(BM_find_long);
+BENCHMARK_STRINGS(BM_find_worst);
+BENCHMARK_STRINGS(BM_find_worst_short);
+BENCHMARK(BM_find_worst_searcher)->Apply(with_sizes);
+BENCHMARK_STRINGS(BM_compare);
+BENCHMARK_STRINGS(BM_equal);
+BENCHMARK_STRINGS(BM_hash);
+
+BENCHMARK_KEYS(BM_construct);
+BENCHMARK_KEYS(BM_copy);
+BENCHMARK_KEYS(BM_compare);
+BENCHMARK_KEYS(BM_equal);
+BENCHMARK_KEYS(BM_hash);
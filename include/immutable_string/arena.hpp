@@ -0,0 +1,159 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <string>
+#include <type_traits>
+
+#include "refcount.hpp"
+#include "string.hpp"
+
+namespace immutable_string {
+
+// Bump allocator taking memory from `Allocator` in chunks, which are all
+// released at once:
+//   arena request_arena;
+//   const arena_string name{"...", request_arena};
+//   ...
+//   request_arena.release();
+// Nothing is freed before release(), which costs one deallocation per
+// chunk, however many strings were made. Not thread-safe.
+template <class Allocator = std::allocator<char>>
+class basic_arena {
+ public:
+  explicit basic_arena(std::size_t chunk_size = 4096,
+                       const Allocator& alloc = Allocator());
+  ~basic_arena() { release(); }
+
+  basic_arena(const basic_arena&) = delete;
+  basic_arena& operator=(const basic_arena&) = delete;
+
+  void* allocate(std::size_t size, std::size_t alignment);
+  // Frees every chunk. Strings allocated from the arena shall not be used
+  // afterwards, though uncounted ones may still be destroyed.
+  void release() noexcept;
+
+ private:
+  struct chunk {
+    chunk* next;
+    std::size_t blocks;
+  };
+  using block = typename std::aligned_storage<sizeof(chunk),
+                                              alignof(std::max_align_t)>::type;
+  using block_allocator =
+      typename std::allocator_traits<Allocator>::template rebind_alloc<block>;
+
+  void _grow(std::size_t size);
+
+  block_allocator m_blocks;
+  std::size_t m_chunk_size;
+  chunk* m_chunks = nullptr;
+  void* m_current = nullptr;
+  std::size_t m_space = 0;
+};
+
+using arena = basic_arena<>;
+
+// Allocates from an arena, deallocating nothing.
+template <class T, class Upstream = std::allocator<char>>
+class arena_allocator {
+ public:
+  using value_type = T;
+  using pointer = T*;
+  using const_pointer = const T*;
+  using reference = T&;
+  using const_reference = const T&;
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+
+  template <class U>
+  struct rebind {
+    using other = arena_allocator<U, Upstream>;
+  };
+
+  arena_allocator(basic_arena<Upstream>& arena) noexcept : m_arena(&arena) {}
+  template <class U>
+  arena_allocator(const arena_allocator<U, Upstream>& other) noexcept
+      : m_arena(other.arena()) {}
+
+  T* allocate(std::size_t n) {
+    if (n > std::size_t(-1) / sizeof(T)) throw std::bad_alloc();
+    return static_cast<T*>(m_arena->allocate(n * sizeof(T), alignof(T)));
+  }
+  void deallocate(T*, std::size_t) noexcept {}
+
+  basic_arena<Upstream>* arena() const noexcept { return m_arena; }
+
+ private:
+  basic_arena<Upstream>* m_arena;
+};
+
+template <class T, class U, class Upstream>
+bool operator==(const arena_allocator<T, Upstream>& lhs,
+                const arena_allocator<U, Upstream>& rhs) noexcept {
+  return lhs.arena() == rhs.arena();
+}
+template <class T, class U, class Upstream>
+bool operator!=(const arena_allocator<T, Upstream>& lhs,
+                const arena_allocator<U, Upstream>& rhs) noexcept {
+  return lhs.arena() != rhs.arena();
+}
+
+// Strings living in an arena, without reference counting.
+template <class CharT, class Traits = std::char_traits<CharT>,
+          class Upstream = std::allocator<char>>
+using basic_arena_string = basic_string<CharT, Traits,
+                                        arena_allocator<CharT, Upstream>,
+                                        uncounted_refcount>;
+
+using arena_string = basic_arena_string<char>;
+using arena_wstring = basic_arena_string<wchar_t>;
+
+template <class Allocator>
+basic_arena<Allocator>::basic_arena(std::size_t chunk_size,
+                                    const Allocator& alloc)
+    : m_blocks(alloc), m_chunk_size(chunk_size) {}
+
+template <class Allocator>
+void* basic_arena<Allocator>::allocate(std::size_t size,
+                                       std::size_t alignment) {
+  if (!std::align(alignment, size, m_current, m_space)) {
+    _grow(size + alignment);
+    std::align(alignment, size, m_current, m_space);
+  }
+  const auto result = m_current;
+  m_current = static_cast<char*>(m_current) + size;
+  m_space -= size;
+  return result;
+}
+
+// Requests larger than a chunk get a chunk of their own.
+template <class Allocator>
+void basic_arena<Allocator>::_grow(std::size_t size) {
+  const auto bytes = std::max(m_chunk_size, size) + sizeof(block);
+  const auto blocks = (bytes + sizeof(block) - 1) / sizeof(block);
+  const auto memory =
+      std::allocator_traits<block_allocator>::allocate(m_blocks, blocks);
+
+  const auto new_chunk = new (memory) chunk{m_chunks, blocks};
+  m_chunks = new_chunk;
+  m_current = memory + 1;
+  m_space = (blocks - 1) * sizeof(block);
+}
+
+template <class Allocator>
+void basic_arena<Allocator>::release() noexcept {
+  while (m_chunks) {
+    const auto next = m_chunks->next;
+    const auto blocks = m_chunks->blocks;
+    std::allocator_traits<block_allocator>::deallocate(
+        m_blocks, reinterpret_cast<block*>(m_chunks), blocks);
+    m_chunks = next;
+  }
+  m_current = nullptr;
+  m_space = 0;
+}
+
+}  // namespace immutable_string
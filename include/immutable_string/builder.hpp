@@ -0,0 +1,361 @@
+#pragma once
+
+#include <cstddef>
+#include <initializer_list>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#if __cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+#if defined(__has_include)
+#if __has_include(<string_view>)
+#include <string_view>
+#define IMMUTABLE_STRING_HAS_STRING_VIEW 1
+#endif
+#endif
+#endif
+
+#include "string.hpp"
+
+namespace immutable_string {
+
+namespace detail {
+
+// Characters of anything concatenation accepts: immutable and standard
+// strings, string views, null-terminated strings and single characters.
+// Refers to the characters, which shall outlive it.
+template <class CharT, class Traits>
+struct piece {
+  template <class Allocator, class RefCount>
+  piece(const basic_string<CharT, Traits, Allocator, RefCount>& str) noexcept
+      : data(str.data()), size(str.size()) {}
+  template <class Allocator>
+  piece(const std::basic_string<CharT, Traits, Allocator>& str) noexcept
+      : data(str.data()), size(str.size()) {}
+#if defined(IMMUTABLE_STRING_HAS_STRING_VIEW)
+  piece(std::basic_string_view<CharT, Traits> str) noexcept
+      : data(str.data()), size(str.size()) {}
+#endif
+  piece(const CharT* s) : data(s), size(Traits::length(s)) {}
+  // exactly CharT, so that no converted temporary is referenced
+  template <class Char, class = typename std::enable_if<
+                            std::is_same<Char, CharT>::value>::type>
+  piece(const Char& ch) noexcept : data(&ch), size(1) {}
+
+  const CharT* data;
+  std::size_t size;
+};
+
+struct concat_access {
+  template <class String>
+  static const typename String::allocator_type* allocator(
+      const String& str) noexcept {
+    return str._is_counted() ? &String::_allocator(str._header()) : nullptr;
+  }
+};
+
+// Allocator of the buffer of an operand of type String, or of a class
+// derived from it, null for other operands and for inline strings and
+// literals, which have none.
+template <class String, class T>
+const typename String::allocator_type* allocator_of(const T& operand,
+                                                    std::true_type) noexcept {
+  return concat_access::allocator<String>(operand);
+}
+template <class String, class T>
+const typename String::allocator_type* allocator_of(const T&,
+                                                    std::false_type) noexcept {
+  return nullptr;
+}
+template <class String, class T>
+const typename String::allocator_type* allocator_of(const T& operand) noexcept {
+  return allocator_of<String>(operand, std::is_base_of<String, T>());
+}
+
+template <class String>
+const typename String::allocator_type* first_allocator() noexcept {
+  return nullptr;
+}
+template <class String, class T, class... Rest>
+const typename String::allocator_type* first_allocator(
+    const T& operand, const Rest&... rest) noexcept {
+  const auto alloc = allocator_of<String>(operand);
+  return alloc ? alloc : first_allocator<String>(rest...);
+}
+
+// Allocator of a concatenation none of whose operands has one. Only a
+// stateless allocator may be made for it: a default constructed pmr
+// allocator would pick the default resource where the operands came from
+// another, and an arena allocator cannot be made at all.
+template <class Allocator>
+using is_stateless_allocator =
+    std::integral_constant<bool,
+                           std::is_empty<Allocator>::value &&
+                               std::is_default_constructible<Allocator>::value>;
+
+template <class Allocator>
+Allocator concat_allocator(std::true_type) {
+  return Allocator();
+}
+template <class Allocator>
+[[noreturn]] Allocator concat_allocator(std::false_type) {
+  throw std::invalid_argument(
+      "concat of inline strings needs an allocator given with "
+      "std::allocator_arg");
+}
+
+template <class Allocator>
+Allocator concat_allocator(const Allocator* alloc) {
+  return alloc ? *alloc
+               : concat_allocator<Allocator>(
+                     is_stateless_allocator<Allocator>());
+}
+
+}  // namespace detail
+
+// Writes the characters of a string of known length straight into its
+// buffer, which build() then hands over without copying:
+//   string_builder builder(scheme.size() + 3 + host.size());
+//   builder.append(scheme).append("://").append(host);
+//   const auto url = builder.build();
+template <class CharT, class Traits = std::char_traits<CharT>,
+          class Allocator = std::allocator<CharT>,
+          class RefCount = atomic_refcount>
+class basic_string_builder {
+ public:
+  using string_type = basic_string<CharT, Traits, Allocator, RefCount>;
+  using size_type = typename string_type::size_type;
+  using piece = detail::piece<CharT, Traits>;
+
+  // Allocates a buffer of `count` characters, unless they fit inline.
+  explicit basic_string_builder(size_type count,
+                                const Allocator& alloc = Allocator());
+
+  basic_string_builder(const basic_string_builder&) = delete;
+  basic_string_builder& operator=(const basic_string_builder&) = delete;
+
+  // Throws std::length_error if the characters do not fit the buffer.
+  basic_string_builder& append(piece str);
+  basic_string_builder& append(const CharT* s, size_type count);
+
+  size_type size() const noexcept { return m_size; }
+  size_type capacity() const noexcept { return m_capacity; }
+
+  // Returns the string built so far and leaves the builder empty. A string
+  // shorter than the buffer is copied into one of its own.
+  string_type build();
+
+ private:
+  Allocator m_alloc;
+  string_type m_result;
+  size_type m_size = 0;
+  size_type m_capacity;
+};
+
+using string_builder = basic_string_builder<char>;
+using wstring_builder = basic_string_builder<wchar_t>;
+
+// Concatenates strings, string views, literals and characters, computing the
+// length first, so that the result is allocated once and written in one
+// pass:
+//   const auto key = concat(tenant, '/', "users/", id);
+// The result has the type of the first string and the allocator of the first
+// string owning a buffer, or the allocator following std::allocator_arg:
+//   concat(std::allocator_arg, arena_allocator<char>(arena), tenant, id);
+// When every string is inline, an allocator with state, as those of arenas
+// and memory resources, shall be given that way, or std::invalid_argument
+// is thrown; a stateless one is default constructed.
+template <class CharT, class Traits, class Allocator, class RefCount,
+          class... Pieces>
+basic_string<CharT, Traits, Allocator, RefCount> concat(
+    std::allocator_arg_t,
+    const typename basic_string<CharT, Traits, Allocator,
+                                RefCount>::allocator_type& alloc,
+    const basic_string<CharT, Traits, Allocator, RefCount>& first,
+    const Pieces&... rest) {
+  using builder_type = basic_string_builder<CharT, Traits, Allocator, RefCount>;
+  const std::initializer_list<typename builder_type::piece> pieces = {first,
+                                                                      rest...};
+  std::size_t count = 0;
+  for (const auto& piece : pieces) count += piece.size;
+
+  builder_type builder(count, alloc);
+  for (const auto& piece : pieces) builder.append(piece);
+  return builder.build();
+}
+template <class CharT, class Traits, class Allocator, class RefCount,
+          class... Pieces>
+basic_string<CharT, Traits, Allocator, RefCount> concat(
+    const basic_string<CharT, Traits, Allocator, RefCount>& first,
+    const Pieces&... rest) {
+  using string_type = basic_string<CharT, Traits, Allocator, RefCount>;
+  return concat(std::allocator_arg,
+                detail::concat_allocator(
+                    detail::first_allocator<string_type>(first, rest...)),
+                first, rest...);
+}
+
+// Concatenation made by a chain of operator+, which is not evaluated until it
+// is converted to a string: the length is summed as the chain grows, then the
+// characters are written into a single buffer, as concat() does. Operands are
+// referenced, so the chain shall be converted within the full expression
+// making it:
+//   const string path = root + '/' + dir + '/' + name;
+// The result has the allocator of the first string operand owning a buffer,
+// as concat() does, or the one passed to str().
+template <class String, class Left>
+class concat_expression {
+ public:
+  using string_type = String;
+  using allocator_type = typename String::allocator_type;
+  using piece = detail::piece<typename String::value_type,
+                              typename String::traits_type>;
+  using builder_type =
+      basic_string_builder<typename String::value_type,
+                           typename String::traits_type, allocator_type,
+                           typename String::refcount_type>;
+
+  // `alloc` is the allocator of the first string operand owning a buffer,
+  // unless one in `left` does.
+  concat_expression(const Left& left, piece right,
+                    const allocator_type* alloc) noexcept
+      : m_left(left),
+        m_right(right),
+        m_size(_size(left) + right.size),
+        m_alloc(_allocator(left) ? _allocator(left) : alloc) {}
+
+  std::size_t size() const noexcept { return m_size; }
+  void append_to(builder_type& builder) const {
+    _append(builder, m_left);
+    builder.append(m_right);
+  }
+
+  string_type str() const { return str(detail::concat_allocator(m_alloc)); }
+  string_type str(const allocator_type& alloc) const {
+    builder_type builder(m_size, alloc);
+    append_to(builder);
+    return builder.build();
+  }
+  operator string_type() const { return str(); }
+
+ private:
+  static std::size_t _size(const piece& p) noexcept { return p.size; }
+  template <class Expression>
+  static const allocator_type* _allocator(const Expression& e) noexcept {
+    return e.m_alloc;
+  }
+  static const allocator_type* _allocator(const piece&) noexcept {
+    return nullptr;
+  }
+  template <class Expression>
+  static std::size_t _size(const Expression& e) noexcept {
+    return e.size();
+  }
+  static void _append(builder_type& builder, const piece& p) {
+    builder.append(p);
+  }
+  template <class Expression>
+  static void _append(builder_type& builder, const Expression& e) {
+    e.append_to(builder);
+  }
+
+  template <class, class>
+  friend class concat_expression;
+
+  Left m_left;
+  piece m_right;
+  std::size_t m_size;
+  const allocator_type* m_alloc;
+};
+
+namespace detail {
+
+// true for immutable strings and the classes derived from them, as symbols
+template <class CharT, class Traits, class Allocator, class RefCount>
+std::true_type immutable_string_base(
+    const basic_string<CharT, Traits, Allocator, RefCount>*);
+std::false_type immutable_string_base(const void*);
+
+template <class T>
+struct is_immutable_string
+    : decltype(immutable_string_base(std::declval<const T*>())) {};
+
+template <class String, class T>
+using enable_if_piece = typename std::enable_if<
+    std::is_convertible<const T&,
+                        piece<typename String::value_type,
+                              typename String::traits_type>>::value,
+    int>::type;
+
+}  // namespace detail
+
+template <class CharT, class Traits, class Alloc, class RefCount, class T,
+          detail::enable_if_piece<basic_string<CharT, Traits, Alloc, RefCount>,
+                                  T> = 0>
+concat_expression<basic_string<CharT, Traits, Alloc, RefCount>,
+                  detail::piece<CharT, Traits>>
+operator+(const basic_string<CharT, Traits, Alloc, RefCount>& lhs,
+          const T& rhs) noexcept {
+  return {lhs, rhs,
+          detail::first_allocator<basic_string<CharT, Traits, Alloc, RefCount>>(
+              lhs, rhs)};
+}
+template <class CharT, class Traits, class Alloc, class RefCount, class T,
+          detail::enable_if_piece<basic_string<CharT, Traits, Alloc, RefCount>,
+                                  T> = 0,
+          class = typename std::enable_if<
+              !detail::is_immutable_string<T>::value>::type>
+concat_expression<basic_string<CharT, Traits, Alloc, RefCount>,
+                  detail::piece<CharT, Traits>>
+operator+(const T& lhs,
+          const basic_string<CharT, Traits, Alloc, RefCount>& rhs) noexcept {
+  return {lhs, rhs,
+          detail::first_allocator<basic_string<CharT, Traits, Alloc, RefCount>>(
+              lhs, rhs)};
+}
+template <class String, class Left, class T,
+          detail::enable_if_piece<String, T> = 0>
+concat_expression<String, concat_expression<String, Left>> operator+(
+    const concat_expression<String, Left>& lhs, const T& rhs) noexcept {
+  return {lhs, rhs, detail::allocator_of<String>(rhs)};
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+basic_string_builder<CharT, Traits, Allocator, RefCount>::basic_string_builder(
+    size_type count, const Allocator& alloc)
+    : m_alloc(alloc), m_capacity(count) {
+  m_result._init(count, alloc);
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+basic_string_builder<CharT, Traits, Allocator, RefCount>&
+basic_string_builder<CharT, Traits, Allocator, RefCount>::append(piece str) {
+  return append(str.data, str.size);
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+basic_string_builder<CharT, Traits, Allocator, RefCount>&
+basic_string_builder<CharT, Traits, Allocator, RefCount>::append(
+    const CharT* s, size_type count) {
+  if (count > m_capacity - m_size) {
+    throw std::length_error("basic_string_builder");
+  }
+  // the buffer is not shared until build()
+  Traits::copy(const_cast<CharT*>(m_result.data()) + m_size, s, count);
+  m_size += count;
+  return *this;
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_string_builder<CharT, Traits, Allocator, RefCount>::string_type
+basic_string_builder<CharT, Traits, Allocator, RefCount>::build() {
+  if (m_size != m_capacity) {
+    m_result = string_type(m_result.data(), m_size, m_alloc);
+  }
+  m_size = m_capacity = 0;
+  return std::move(m_result);
+}
+
+}  // namespace immutable_string
@@ -0,0 +1,395 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+#if !defined(IMMUTABLE_STRING_NO_SIMD) && \
+    (defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__))
+#define IMMUTABLE_STRING_X86_SIMD 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#define IMMUTABLE_STRING_TARGET_AVX2
+#else
+#define IMMUTABLE_STRING_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace immutable_string {
+namespace detail {
+
+const std::size_t not_found = std::size_t(-1);
+
+// Vectorized kernels are used for byte-sized characters compared by the
+// standard traits; other strings go through Traits::find and Traits::compare.
+template <class CharT, class Traits>
+struct is_byte_searchable
+    : std::integral_constant<bool,
+                             sizeof(CharT) == 1 &&
+                                 std::is_integral<CharT>::value &&
+                                 std::is_same<Traits,
+                                              std::char_traits<CharT>>::value> {
+};
+
+inline unsigned count_trailing_zeros(unsigned mask) noexcept {
+#if defined(_MSC_VER) && !defined(__clang__)
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return index;
+#else
+  return __builtin_ctz(mask);
+#endif
+}
+
+// scalar, though memchr is vectorized by most C libraries
+inline std::size_t find_char_scalar(const char* s, std::size_t n,
+                                    char ch) noexcept {
+  if (n == 0) return not_found;
+  const auto found = static_cast<const char*>(std::memchr(s, ch, n));
+  return found ? static_cast<std::size_t>(found - s) : not_found;
+}
+
+inline std::size_t find_scalar(const char* s, std::size_t n,
+                               const char* needle, std::size_t count) noexcept {
+  for (std::size_t i = 0; i + count <= n; ++i) {
+    if (s[i] == needle[0] && s[i + count - 1] == needle[count - 1] &&
+        std::memcmp(s + i + 1, needle + 1, count - 2) == 0) {
+      return i;
+    }
+  }
+  return not_found;
+}
+
+// Characters the vectorized kernels may compare while checking candidates
+// before `pos`. Past it they hand the rest of the text over to two_way: the
+// filter on the first and the last character is much faster on typical text,
+// two_way keeps repetitive text linear.
+inline std::size_t find_budget(std::size_t pos, std::size_t count) noexcept {
+  return 2 * pos + 8 * count;
+}
+
+#if defined(IMMUTABLE_STRING_X86_SIMD)
+
+// SSE2 is part of x86-64, so these need no dispatch.
+inline std::size_t find_char_sse2(const char* s, std::size_t n,
+                                  char ch) noexcept {
+  const auto needle = _mm_set1_epi8(ch);
+  std::size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    const auto block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+    const auto mask = static_cast<unsigned>(
+        _mm_movemask_epi8(_mm_cmpeq_epi8(block, needle)));
+    if (mask != 0) return i + count_trailing_zeros(mask);
+  }
+  const auto rest = find_char_scalar(s + i, n - i, ch);
+  return rest == not_found ? not_found : i + rest;
+}
+
+// Compares the first and the last character of the needle at 16 positions at
+// once and checks the middle only where both match. Gives up once checking
+// has cost more than find_budget allows, returning not_found with `stop` set
+// to the first position left unchecked; `stop` is n otherwise.
+inline std::size_t find_sse2(const char* s, std::size_t n, const char* needle,
+                             std::size_t count, std::size_t& stop) noexcept {
+  const auto first = _mm_set1_epi8(needle[0]);
+  const auto last = _mm_set1_epi8(needle[count - 1]);
+  std::size_t spent = 0;
+  std::size_t i = 0;
+  for (; i + count - 1 + 16 <= n; i += 16) {
+    const auto block_first =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+    const auto block_last =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i + count - 1));
+    auto mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_and_si128(
+        _mm_cmpeq_epi8(block_first, first), _mm_cmpeq_epi8(block_last, last))));
+    while (mask != 0) {
+      const auto bit = count_trailing_zeros(mask);
+      spent += count - 2;
+      if (spent > find_budget(i + bit, count)) {
+        stop = i + bit;
+        return not_found;
+      }
+      if (std::memcmp(s + i + bit + 1, needle + 1, count - 2) == 0) {
+        return i + bit;
+      }
+      mask &= mask - 1;
+    }
+  }
+  stop = n;
+  const auto rest = find_scalar(s + i, n - i, needle, count);
+  return rest == not_found ? not_found : i + rest;
+}
+
+IMMUTABLE_STRING_TARGET_AVX2
+inline std::size_t find_char_avx2(const char* s, std::size_t n,
+                                  char ch) noexcept {
+  const auto needle = _mm256_set1_epi8(ch);
+  std::size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    const auto block =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+    const auto mask = static_cast<unsigned>(
+        _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, needle)));
+    if (mask != 0) return i + count_trailing_zeros(mask);
+  }
+  const auto rest = find_char_sse2(s + i, n - i, ch);
+  return rest == not_found ? not_found : i + rest;
+}
+
+IMMUTABLE_STRING_TARGET_AVX2
+inline std::size_t find_avx2(const char* s, std::size_t n, const char* needle,
+                             std::size_t count, std::size_t& stop) noexcept {
+  const auto first = _mm256_set1_epi8(needle[0]);
+  const auto last = _mm256_set1_epi8(needle[count - 1]);
+  std::size_t spent = 0;
+  std::size_t i = 0;
+  for (; i + count - 1 + 32 <= n; i += 32) {
+    const auto block_first =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+    const auto block_last = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(s + i + count - 1));
+    auto mask = static_cast<unsigned>(_mm256_movemask_epi8(
+        _mm256_and_si256(_mm256_cmpeq_epi8(block_first, first),
+                         _mm256_cmpeq_epi8(block_last, last))));
+    while (mask != 0) {
+      const auto bit = count_trailing_zeros(mask);
+      spent += count - 2;
+      if (spent > find_budget(i + bit, count)) {
+        stop = i + bit;
+        return not_found;
+      }
+      if (std::memcmp(s + i + bit + 1, needle + 1, count - 2) == 0) {
+        return i + bit;
+      }
+      mask &= mask - 1;
+    }
+  }
+  const auto rest = find_sse2(s + i, n - i, needle, count, stop);
+  stop += i;
+  return rest == not_found ? not_found : i + rest;
+}
+
+inline bool detect_avx2() noexcept {
+#if defined(_MSC_VER) && !defined(__clang__)
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7) return false;
+  __cpuid(info, 1);
+  // the OS shall save the AVX registers
+  const bool osxsave = (info[2] & (1 << 27)) != 0;
+  if (!osxsave || (_xgetbv(0) & 6) != 6) return false;
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+#else
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+#endif
+}
+
+inline bool has_avx2() noexcept {
+  static const bool value = detect_avx2();
+  return value;
+}
+
+#endif  // IMMUTABLE_STRING_X86_SIMD
+
+// Returns the position of `ch` in [s, s + n) or not_found.
+inline std::size_t find_char(const char* s, std::size_t n, char ch) noexcept {
+#if defined(IMMUTABLE_STRING_X86_SIMD)
+  if (has_avx2()) return find_char_avx2(s, n, ch);
+  return find_char_sse2(s, n, ch);
+#else
+  return find_char_scalar(s, n, ch);
+#endif
+}
+
+// Needles at least this long of characters the kernels above do not take are
+// searched with two_way, which does not degrade on repetitive text.
+const std::size_t two_way_threshold = 32;
+
+// Crochemore-Perrin Two-Way string matching: linear time, constant space.
+// Holds the factorization of the needle only, which is passed to find.
+template <class CharT, class Traits>
+class two_way {
+ public:
+  two_way(const CharT* needle, std::size_t count) noexcept;
+
+  // Returns the position of the needle in [s, s + n) or not_found.
+  std::size_t find(const CharT* needle, const CharT* s,
+                   std::size_t n) const noexcept;
+
+ private:
+  std::size_t _maximal_suffix(const CharT* needle, bool reversed,
+                              std::size_t& period) const noexcept;
+
+  std::size_t m_count;
+  // the needle is split into [0, m_suffix) and [m_suffix, m_count)
+  std::size_t m_suffix;
+  std::size_t m_period;
+  bool m_periodic;
+};
+
+template <class CharT, class Traits>
+two_way<CharT, Traits>::two_way(const CharT* needle,
+                                std::size_t count) noexcept
+    : m_count(count) {
+  std::size_t period;
+  std::size_t reversed_period;
+  const auto suffix = _maximal_suffix(needle, false, period);
+  const auto reversed_suffix =
+      _maximal_suffix(needle, true, reversed_period);
+  // not_found + 1 is 0, the whole needle being the suffix
+  if (suffix + 1 < reversed_suffix + 1) {
+    m_suffix = reversed_suffix + 1;
+    m_period = reversed_period;
+  } else {
+    m_suffix = suffix + 1;
+    m_period = period;
+  }
+
+  m_periodic = m_suffix + m_period <= m_count &&
+               Traits::compare(needle, needle + m_period, m_suffix) == 0;
+  if (!m_periodic) m_period = std::max(m_suffix, m_count - m_suffix) + 1;
+}
+
+// Returns the start of the maximal suffix minus one, wrapping around for the
+// whole needle, and its period.
+template <class CharT, class Traits>
+std::size_t two_way<CharT, Traits>::_maximal_suffix(
+    const CharT* needle, bool reversed, std::size_t& period) const noexcept {
+  auto suffix = not_found;
+  std::size_t j = 0;
+  std::size_t k = 1;
+  period = 1;
+  while (j + k < m_count) {
+    const auto a = needle[j + k];
+    const auto b = needle[suffix + k];
+    if (reversed ? Traits::lt(b, a) : Traits::lt(a, b)) {
+      j += k;
+      k = 1;
+      period = j - suffix;
+    } else if (Traits::eq(a, b)) {
+      if (k != period) {
+        ++k;
+      } else {
+        j += period;
+        k = 1;
+      }
+    } else {
+      suffix = j++;
+      k = period = 1;
+    }
+  }
+  return suffix;
+}
+
+template <class CharT, class Traits>
+std::size_t two_way<CharT, Traits>::find(const CharT* needle,
+                                         const CharT* s,
+                                         std::size_t n) const noexcept {
+  // the prefix of the needle already known to match after a periodic shift
+  std::size_t memory = 0;
+  for (std::size_t j = 0; j + m_count <= n;) {
+    auto i = std::max(m_suffix, memory);
+    while (i < m_count && Traits::eq(needle[i], s[i + j])) ++i;
+    if (i < m_count) {
+      j += i - m_suffix + 1;
+      memory = 0;
+      continue;
+    }
+
+    i = m_suffix;
+    while (i > memory && Traits::eq(needle[i - 1], s[i - 1 + j])) --i;
+    if (i <= memory) return j;
+    j += m_period;
+    if (m_periodic) memory = m_count - m_period;
+  }
+  return not_found;
+}
+
+// Factorization of needles of the kernels above.
+using byte_two_way = two_way<char, std::char_traits<char>>;
+
+// Searches [s + stop, s + n) with the factorization of the needle, for
+// kernels which gave up at `stop` after returning `found`.
+inline std::size_t find_rest(const char* s, std::size_t n, const char* needle,
+                             std::size_t found, std::size_t stop,
+                             const byte_two_way& factorization) noexcept {
+  if (found != not_found || stop == n) return found;
+  const auto rest = factorization.find(needle, s + stop, n - stop);
+  return rest == not_found ? not_found : stop + rest;
+}
+// Factorizes the needle only if the kernel gave up.
+inline std::size_t find_rest(const char* s, std::size_t n, const char* needle,
+                             std::size_t count, std::size_t found,
+                             std::size_t stop) noexcept {
+  if (found != not_found || stop == n) return found;
+  return find_rest(s, n, needle, found, stop, byte_two_way(needle, count));
+}
+
+#if defined(IMMUTABLE_STRING_X86_SIMD)
+inline std::size_t find_sse2(const char* s, std::size_t n, const char* needle,
+                             std::size_t count) noexcept {
+  std::size_t stop = n;
+  const auto found = find_sse2(s, n, needle, count, stop);
+  return find_rest(s, n, needle, count, found, stop);
+}
+inline std::size_t find_sse2(const char* s, std::size_t n, const char* needle,
+                             std::size_t count,
+                             const byte_two_way& factorization) noexcept {
+  std::size_t stop = n;
+  const auto found = find_sse2(s, n, needle, count, stop);
+  return find_rest(s, n, needle, found, stop, factorization);
+}
+
+IMMUTABLE_STRING_TARGET_AVX2
+inline std::size_t find_avx2(const char* s, std::size_t n, const char* needle,
+                             std::size_t count) noexcept {
+  std::size_t stop = n;
+  const auto found = find_avx2(s, n, needle, count, stop);
+  return find_rest(s, n, needle, count, found, stop);
+}
+IMMUTABLE_STRING_TARGET_AVX2
+inline std::size_t find_avx2(const char* s, std::size_t n, const char* needle,
+                             std::size_t count,
+                             const byte_two_way& factorization) noexcept {
+  std::size_t stop = n;
+  const auto found = find_avx2(s, n, needle, count, stop);
+  return find_rest(s, n, needle, found, stop, factorization);
+}
+#endif
+
+// Returns the position of the needle in [s, s + n) or not_found, in linear
+// time. The needle shall be at least two characters long.
+inline std::size_t find(const char* s, std::size_t n, const char* needle,
+                        std::size_t count) noexcept {
+#if defined(IMMUTABLE_STRING_X86_SIMD)
+  if (has_avx2()) return find_avx2(s, n, needle, count);
+  return find_sse2(s, n, needle, count);
+#else
+  if (count < two_way_threshold) return find_scalar(s, n, needle, count);
+  return byte_two_way(needle, count).find(needle, s, n);
+#endif
+}
+// The same with the factorization of the needle made beforehand, as
+// searchers do.
+inline std::size_t find(const char* s, std::size_t n, const char* needle,
+                        std::size_t count,
+                        const byte_two_way& factorization) noexcept {
+#if defined(IMMUTABLE_STRING_X86_SIMD)
+  if (has_avx2()) return find_avx2(s, n, needle, count, factorization);
+  return find_sse2(s, n, needle, count, factorization);
+#else
+  if (count < two_way_threshold) return find_scalar(s, n, needle, count);
+  return factorization.find(needle, s, n);
+#endif
+}
+
+}  // namespace detail
+}  // namespace immutable_string
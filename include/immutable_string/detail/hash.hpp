@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(_MSC_VER) && defined(_M_X64) && !defined(__SIZEOF_INT128__)
+#include <intrin.h>
+#endif
+
+namespace immutable_string {
+namespace detail {
+
+// wyhash by Wang Yi (public domain): a fast hash of good quality, which
+// reads 16 bytes per multiplication.
+namespace wyhash {
+
+const std::uint64_t secret[4] = {0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull,
+                                 0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull};
+
+// Replaces a and b with the low and the high half of their product.
+inline void multiply(std::uint64_t& a, std::uint64_t& b) noexcept {
+#if defined(__SIZEOF_INT128__)
+  __extension__ typedef unsigned __int128 uint128;
+  const auto product = static_cast<uint128>(a) * b;
+  a = static_cast<std::uint64_t>(product);
+  b = static_cast<std::uint64_t>(product >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+  a = _umul128(a, b, &b);
+#else
+  const std::uint64_t a_high = a >> 32, a_low = a & 0xffffffff;
+  const std::uint64_t b_high = b >> 32, b_low = b & 0xffffffff;
+  const auto high = a_high * b_high, low = a_low * b_low;
+  const auto middle1 = a_high * b_low, middle2 = a_low * b_high;
+  const auto carry =
+      ((low >> 32) + (middle1 & 0xffffffff) + (middle2 & 0xffffffff)) >> 32;
+  a = low + (middle1 << 32) + (middle2 << 32);
+  b = high + (middle1 >> 32) + (middle2 >> 32) + carry;
+#endif
+}
+
+inline std::uint64_t mix(std::uint64_t a, std::uint64_t b) noexcept {
+  multiply(a, b);
+  return a ^ b;
+}
+
+inline std::uint64_t read8(const unsigned char* p) noexcept {
+  std::uint64_t value;
+  std::memcpy(&value, p, 8);
+  return value;
+}
+inline std::uint64_t read4(const unsigned char* p) noexcept {
+  std::uint32_t value;
+  std::memcpy(&value, p, 4);
+  return value;
+}
+inline std::uint64_t read3(const unsigned char* p, std::size_t n) noexcept {
+  return (std::uint64_t(p[0]) << 16) | (std::uint64_t(p[n >> 1]) << 8) |
+         p[n - 1];
+}
+
+inline std::uint64_t hash(const void* key, std::size_t n,
+                          std::uint64_t seed = 0) noexcept {
+  auto p = static_cast<const unsigned char*>(key);
+  seed ^= mix(seed ^ secret[0], secret[1]);
+  std::uint64_t a, b;
+  if (n <= 16) {
+    if (n >= 4) {
+      const auto middle = (n >> 3) << 2;
+      a = (read4(p) << 32) | read4(p + middle);
+      b = (read4(p + n - 4) << 32) | read4(p + n - 4 - middle);
+    } else if (n > 0) {
+      a = read3(p, n);
+      b = 0;
+    } else {
+      a = b = 0;
+    }
+  } else {
+    auto i = n;
+    if (i > 48) {
+      auto seed1 = seed, seed2 = seed;
+      do {
+        seed = mix(read8(p) ^ secret[1], read8(p + 8) ^ seed);
+        seed1 = mix(read8(p + 16) ^ secret[2], read8(p + 24) ^ seed1);
+        seed2 = mix(read8(p + 32) ^ secret[3], read8(p + 40) ^ seed2);
+        p += 48;
+        i -= 48;
+      } while (i > 48);
+      seed ^= seed1 ^ seed2;
+    }
+    while (i > 16) {
+      seed = mix(read8(p) ^ secret[1], read8(p + 8) ^ seed);
+      i -= 16;
+      p += 16;
+    }
+    a = read8(p + i - 16);
+    b = read8(p + i - 8);
+  }
+  a ^= secret[1];
+  b ^= seed;
+  multiply(a, b);
+  return mix(a ^ secret[0] ^ n, b ^ secret[1]);
+}
+
+}  // namespace wyhash
+
+}  // namespace detail
+}  // namespace immutable_string
@@ -0,0 +1,242 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "string.hpp"
+
+namespace immutable_string {
+
+// Epoch-based reclamation: readers pin the current epoch with a guard, and
+// objects retired by writers are freed once every reader has left the epoch
+// they were retired in. Entering and leaving a guard touches only a word of
+// the calling thread. The global epoch moves on when collect() finds every
+// active reader in it, so an object is freed two epochs after its retirement;
+// retire() collects as well.
+class epoch {
+  struct record;
+
+ public:
+  // Pins the current epoch on the calling thread; guards may nest.
+  class guard {
+   public:
+    guard();
+    ~guard();
+
+    guard(const guard&) = delete;
+    guard& operator=(const guard&) = delete;
+
+   private:
+    record* m_record;
+  };
+
+  // Frees `p` with `free` once no guard entered before now remains.
+  static void retire(void* p, void (*free)(void*));
+  template <class T>
+  static void retire(T* p) {
+    retire(p, [](void* q) { delete static_cast<T*>(q); });
+  }
+
+  // Advances the epoch if it can and frees what readers can no longer reach,
+  // returns the number of objects freed.
+  static std::size_t collect();
+
+ private:
+  static const std::size_t cache_line = 64;
+
+  // Epochs start at 1, 0 marks a thread outside any guard. Every record fills
+  // cache lines of its own, as its thread writes the epoch and the nesting
+  // on every guard.
+  struct alignas(cache_line) record {
+    std::atomic<std::uint64_t> epoch{0};
+    unsigned nesting = 0;
+    std::atomic<bool> in_use{true};
+    record* next = nullptr;
+  };
+
+  struct retired {
+    std::uint64_t epoch;
+    void* p;
+    void (*free)(void*);
+  };
+
+  struct state {
+    std::atomic<std::uint64_t> global{1};
+    // records are never freed, only reused once their thread exits
+    std::atomic<record*> records{nullptr};
+    std::mutex mutex;
+    std::vector<retired> pending;
+    // set at exit, when no reader is left, from then on retire() frees
+    bool exited = false;
+  };
+
+  // Frees what is pending at exit. Objects retired later, by destructors of
+  // statics made before the state, are freed at once.
+  struct exit_cleanup {
+    ~exit_cleanup();
+  };
+
+  struct thread_holder {
+    record* r = _acquire_record();
+    ~thread_holder() { r->in_use.store(false, std::memory_order_release); }
+  };
+
+  static state& _state() {
+    // never destroyed, so that statics destroyed after it may retire
+    static state& s = *new state;
+    static exit_cleanup cleanup;
+    return s;
+  }
+  static record* _local() {
+    static thread_local thread_holder holder;
+    return holder.r;
+  }
+  static record* _acquire_record();
+};
+
+// Immutable string published to readers, which use it under an epoch guard
+// without copying it, so without touching its reference count:
+//   published<string> config{load_config()};
+//   ...
+//   epoch::guard guard;
+//   const string& current = config.load(guard);
+// store() replaces the string and retires the previous one, which is freed
+// after the readers holding it leave their guards. A reader keeping the
+// string longer copies it.
+template <class String>
+class published {
+  static_assert(String::is_thread_safe,
+                "published strings are released by any thread");
+
+ public:
+  published() : published(String()) {}
+  explicit published(String str) : m_current(new String(std::move(str))) {}
+  ~published() { epoch::retire(m_current.load(std::memory_order_relaxed)); }
+
+  published(const published&) = delete;
+  published& operator=(const published&) = delete;
+
+  // The string stays valid while `guard` lives.
+  const String& load(const epoch::guard&) const noexcept {
+    return *m_current.load(std::memory_order_acquire);
+  }
+  // Copy of the current string, for use beyond a guard.
+  String copy() const {
+    epoch::guard guard;
+    return load(guard);
+  }
+
+  void store(String str) {
+    const auto next = new String(std::move(str));
+    epoch::retire(m_current.exchange(next));
+  }
+
+ private:
+  std::atomic<String*> m_current;
+};
+
+inline epoch::guard::guard() : m_record(_local()) {
+  if (m_record->nesting++ != 0) return;
+  m_record->epoch.store(_state().global.load(std::memory_order_acquire),
+                        std::memory_order_relaxed);
+  // the epoch is announced before anything protected is read
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+inline epoch::guard::~guard() {
+  if (--m_record->nesting == 0) {
+    m_record->epoch.store(0, std::memory_order_release);
+  }
+}
+
+inline void epoch::retire(void* p, void (*free)(void*)) {
+  auto& s = _state();
+  {
+    std::lock_guard<std::mutex> lock(s.mutex);
+    if (!s.exited) {
+      s.pending.push_back(
+          retired{s.global.load(std::memory_order_seq_cst), p, free});
+      p = nullptr;
+    }
+  }
+  if (p) {
+    free(p);
+    return;
+  }
+  collect();
+}
+
+// Readers seen in the current epoch may still hold what was retired in the
+// previous one, but none may hold what was retired before.
+inline std::size_t epoch::collect() {
+  auto& s = _state();
+  std::vector<retired> ready;
+  {
+    std::lock_guard<std::mutex> lock(s.mutex);
+    const auto current = s.global.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto can_advance = true;
+    for (auto r = s.records.load(std::memory_order_acquire); r; r = r->next) {
+      const auto e = r->epoch.load(std::memory_order_acquire);
+      if (e != 0 && e != current) can_advance = false;
+    }
+    const auto global = can_advance ? current + 1 : current;
+    if (can_advance) s.global.store(global, std::memory_order_seq_cst);
+
+    auto keep = s.pending.begin();
+    for (auto& r : s.pending) {
+      if (r.epoch + 2 <= global) {
+        ready.push_back(r);
+      } else {
+        *keep++ = r;
+      }
+    }
+    s.pending.erase(keep, s.pending.end());
+  }
+  // outside the lock, as freeing may retire more
+  for (const auto& r : ready) r.free(r.p);
+  return ready.size();
+}
+
+inline epoch::exit_cleanup::~exit_cleanup() {
+  auto& s = _state();
+  std::vector<retired> pending;
+  {
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.exited = true;
+    pending.swap(s.pending);
+  }
+  for (const auto& r : pending) r.free(r.p);
+}
+
+inline epoch::record* epoch::_acquire_record() {
+  auto& s = _state();
+  for (auto r = s.records.load(std::memory_order_acquire); r; r = r->next) {
+    auto in_use = false;
+    if (!r->in_use.load(std::memory_order_relaxed) &&
+        r->in_use.compare_exchange_strong(in_use, true,
+                                          std::memory_order_acquire)) {
+      return r;
+    }
+  }
+  // plain new does not align to a cache line before C++17; records are never
+  // freed, so the allocated address is not kept
+  auto space = sizeof(record) + alignof(record) - 1;
+  void* memory = ::operator new(space);
+  std::align(alignof(record), sizeof(record), memory, space);
+  const auto r = new (memory) record;
+  auto head = s.records.load(std::memory_order_relaxed);
+  do {
+    r->next = head;
+  } while (!s.records.compare_exchange_weak(head, r, std::memory_order_release,
+                                            std::memory_order_relaxed));
+  return r;
+}
+
+}  // namespace immutable_string
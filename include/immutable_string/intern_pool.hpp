@@ -0,0 +1,222 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "string.hpp"
+
+namespace immutable_string {
+
+// Maps the characters of strings to a single canonical copy, so that equal
+// strings share one buffer:
+//   intern_pool pool;
+//   const auto host = pool.intern(received_host);
+// Entries are split into shards by hash, each with its own lock. The pool
+// keeps entries only while someone else references them: a shard drops the
+// unreferenced ones once it has doubled since the last sweep, and reclaim()
+// drops them all. Inline strings are returned as they are.
+template <class CharT, class Traits = std::char_traits<CharT>,
+          class Allocator = std::allocator<CharT>,
+          class RefCount = atomic_refcount>
+class basic_intern_pool {
+  static_assert(RefCount::is_thread_safe,
+                "interned strings are shared between threads");
+  static_assert(RefCount::has_exact_use_count,
+                "unreferenced entries are found by their use_count()");
+
+ public:
+  using string_type = basic_string<CharT, Traits, Allocator, RefCount>;
+  using size_type = typename string_type::size_type;
+
+  struct statistics {
+    std::size_t lookups = 0;
+    std::size_t hits = 0;
+    std::size_t entries = 0;
+    // entries dropped as unreferenced
+    std::size_t reclaimed = 0;
+    // size of the characters of hits, which needed no buffer of their own
+    std::size_t bytes_saved = 0;
+
+    double hit_rate() const noexcept {
+      return lookups == 0 ? 0 : static_cast<double>(hits) / lookups;
+    }
+  };
+
+  explicit basic_intern_pool(const Allocator& alloc = Allocator(),
+                             std::size_t shards = 16);
+
+  basic_intern_pool(const basic_intern_pool&) = delete;
+  basic_intern_pool& operator=(const basic_intern_pool&) = delete;
+
+  // Returns the canonical string with the characters of `str`. Substrings,
+  // adopted buffers and buffers of another allocator than the pool's are
+  // stored as copies, so the pool keeps alive neither their parents nor
+  // buffers owned elsewhere, nor points into a memory resource released
+  // before it.
+  string_type intern(const string_type& str);
+  string_type intern(const CharT* s, size_type count);
+  string_type intern(const CharT* s) { return intern(s, Traits::length(s)); }
+
+  // Drops the entries referenced by the pool only, returns their number.
+  std::size_t reclaim();
+  std::size_t size() const;
+  statistics stats() const;
+
+ private:
+  static const std::size_t min_sweep = 64;
+
+  struct shard {
+    std::mutex mutex;
+    std::unordered_multimap<std::size_t, string_type> entries;
+    std::size_t sweep_at = min_sweep;
+    statistics stats;
+  };
+
+  shard& _shard(std::size_t hash) const noexcept {
+    // the low bits pick the bucket inside the shard
+    return m_shards[(hash >> 16) & (m_shard_count - 1)];
+  }
+  template <class MakeString>
+  string_type _intern(std::size_t hash, const CharT* s, size_type count,
+                      MakeString make);
+  static std::size_t _sweep(shard& s);
+
+  Allocator m_alloc;
+  std::size_t m_shard_count;
+  std::unique_ptr<shard[]> m_shards;
+};
+
+using intern_pool = basic_intern_pool<char>;
+using wintern_pool = basic_intern_pool<wchar_t>;
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+const std::size_t
+    basic_intern_pool<CharT, Traits, Allocator, RefCount>::min_sweep;
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+basic_intern_pool<CharT, Traits, Allocator, RefCount>::basic_intern_pool(
+    const Allocator& alloc, std::size_t shards)
+    : m_alloc(alloc), m_shard_count(1) {
+  while (m_shard_count < shards) m_shard_count <<= 1;
+  m_shards.reset(new shard[m_shard_count]);
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_intern_pool<CharT, Traits, Allocator, RefCount>::string_type
+basic_intern_pool<CharT, Traits, Allocator, RefCount>::intern(
+    const string_type& str) {
+  if (str.size() <= string_type::local_capacity) {
+    return intern(str.data(), str.size());
+  }
+  return _intern(str.hash(), str.data(), str.size(), [this, &str] {
+    // literals are static and pin nothing
+    if (!str._is_counted()) return str;
+    const auto header = str._header();
+    if (string_type::_is_buffer(header) &&
+        string_type::_allocator(header) == m_alloc) {
+      return str;
+    }
+    return string_type(str.data(), str.size(), m_alloc);
+  });
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_intern_pool<CharT, Traits, Allocator, RefCount>::string_type
+basic_intern_pool<CharT, Traits, Allocator, RefCount>::intern(
+    const CharT* s, size_type count) {
+  if (count <= string_type::local_capacity) {
+    return string_type(s, count, m_alloc);
+  }
+  return _intern(string_type::_hash(s, count), s, count,
+                 [this, s, count] { return string_type(s, count, m_alloc); });
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+template <class MakeString>
+typename basic_intern_pool<CharT, Traits, Allocator, RefCount>::string_type
+basic_intern_pool<CharT, Traits, Allocator, RefCount>::_intern(
+    std::size_t hash, const CharT* s, size_type count, MakeString make) {
+  auto& shard = _shard(hash);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  ++shard.stats.lookups;
+
+  const auto range = shard.entries.equal_range(hash);
+  for (auto it = range.first; it != range.second; ++it) {
+    const auto& entry = it->second;
+    if (entry.size() == count &&
+        Traits::compare(entry.data(), s, count) == 0) {
+      ++shard.stats.hits;
+      shard.stats.bytes_saved += count * sizeof(CharT);
+      return entry;
+    }
+  }
+
+  if (shard.entries.size() >= shard.sweep_at) {
+    shard.stats.reclaimed += _sweep(shard);
+    shard.sweep_at = std::max(2 * shard.entries.size(), min_sweep);
+  }
+  return shard.entries.emplace(hash, make())->second;
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+std::size_t basic_intern_pool<CharT, Traits, Allocator, RefCount>::reclaim() {
+  std::size_t reclaimed = 0;
+  for (std::size_t i = 0; i < m_shard_count; ++i) {
+    auto& shard = m_shards[i];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    const auto count = _sweep(shard);
+    shard.stats.reclaimed += count;
+    reclaimed += count;
+  }
+  return reclaimed;
+}
+
+// Strings are handed out under the lock only, so an entry referenced by the
+// shard alone stays so until it is erased.
+template <class CharT, class Traits, class Allocator, class RefCount>
+std::size_t basic_intern_pool<CharT, Traits, Allocator, RefCount>::_sweep(
+    shard& s) {
+  std::size_t count = 0;
+  for (auto it = s.entries.begin(); it != s.entries.end();) {
+    if (it->second.use_count() == 1) {
+      it = s.entries.erase(it);
+      ++count;
+    } else {
+      ++it;
+    }
+  }
+  return count;
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+std::size_t basic_intern_pool<CharT, Traits, Allocator, RefCount>::size()
+    const {
+  std::size_t count = 0;
+  for (std::size_t i = 0; i < m_shard_count; ++i) {
+    std::lock_guard<std::mutex> lock(m_shards[i].mutex);
+    count += m_shards[i].entries.size();
+  }
+  return count;
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_intern_pool<CharT, Traits, Allocator, RefCount>::statistics
+basic_intern_pool<CharT, Traits, Allocator, RefCount>::stats() const {
+  statistics total;
+  for (std::size_t i = 0; i < m_shard_count; ++i) {
+    auto& shard = m_shards[i];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    total.lookups += shard.stats.lookups;
+    total.hits += shard.stats.hits;
+    total.entries += shard.entries.size();
+    total.reclaimed += shard.stats.reclaimed;
+    total.bytes_saved += shard.stats.bytes_saved;
+  }
+  return total;
+}
+
+}  // namespace immutable_string
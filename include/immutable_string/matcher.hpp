@@ -0,0 +1,264 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <initializer_list>
+#include <stdexcept>
+#include <vector>
+
+#include "string.hpp"
+
+namespace immutable_string {
+
+// Aho-Corasick automaton reporting the occurrences of any of its patterns in
+// one pass over a string:
+//   const matcher keywords{string{"he"}, string{"she"}, string{"hers"}};
+//   keywords.for_each_match(text, [](const matcher::match& m) { ... });
+// Characters are mapped to the classes of the characters occurring in the
+// patterns, so that the transition table is dense and small. If every
+// pattern starts with the same character, the text between matches is
+// skipped with find.
+template <class CharT, class Traits = std::char_traits<CharT>,
+          class Allocator = std::allocator<CharT>,
+          class RefCount = atomic_refcount>
+class basic_matcher {
+ public:
+  using string_type = basic_string<CharT, Traits, Allocator, RefCount>;
+  using size_type = typename string_type::size_type;
+
+  struct match {
+    // index of the pattern
+    size_type pattern;
+    // position of its first character in the text
+    size_type pos;
+  };
+
+  // Empty patterns never match.
+  template <class InputIt>
+  basic_matcher(InputIt first, InputIt last);
+  basic_matcher(std::initializer_list<string_type> patterns)
+      : basic_matcher(patterns.begin(), patterns.end()) {}
+
+  size_type size() const noexcept { return m_patterns.size(); }
+  const string_type& pattern(size_type index) const noexcept {
+    return m_patterns[index];
+  }
+
+  // Calls callback(const match&) for every match, ordered by their ends and
+  // longer ones first.
+  template <class Callback>
+  void for_each_match(const string_type& text, Callback callback) const;
+  std::vector<match> find_all(const string_type& text) const;
+  bool contains_any(const string_type& text) const;
+
+ private:
+  using state_type = std::uint32_t;
+  using searchable = detail::is_byte_searchable<CharT, Traits>;
+
+  static constexpr state_type none = state_type(-1);
+
+  std::size_t _class(CharT ch) const noexcept {
+    return _class(ch, searchable{});
+  }
+  std::size_t _class(CharT ch, std::true_type) const noexcept {
+    return m_byte_class[static_cast<unsigned char>(ch)];
+  }
+  std::size_t _class(CharT ch, std::false_type) const noexcept;
+  state_type _add_state();
+  void _build_alphabet();
+  void _build_trie();
+  void _link();
+  template <class Visitor>
+  bool _scan(const CharT* s, size_type n, Visitor visit) const;
+
+  std::vector<string_type> m_patterns;
+  // characters of the patterns sorted by Traits::lt, class i + 1 each
+  std::vector<CharT> m_alphabet;
+  std::vector<std::uint16_t> m_byte_class;
+  std::size_t m_classes = 1;
+  // m_classes transitions per state, the root being state 0
+  std::vector<state_type> m_next;
+  // the last pattern ending at a state, followed by its duplicates in m_same
+  std::vector<state_type> m_output;
+  std::vector<state_type> m_same;
+  // the longest proper suffix of a state with an output
+  std::vector<state_type> m_dictionary;
+  bool m_single_start = false;
+  CharT m_start = CharT();
+};
+
+using matcher = basic_matcher<char>;
+using wmatcher = basic_matcher<wchar_t>;
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+constexpr typename basic_matcher<CharT, Traits, Allocator,
+                                 RefCount>::state_type
+    basic_matcher<CharT, Traits, Allocator, RefCount>::none;
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+template <class InputIt>
+basic_matcher<CharT, Traits, Allocator, RefCount>::basic_matcher(
+    InputIt first, InputIt last)
+    : m_patterns(first, last) {
+  _build_alphabet();
+  _build_trie();
+  _link();
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+template <class Callback>
+void basic_matcher<CharT, Traits, Allocator, RefCount>::for_each_match(
+    const string_type& text, Callback callback) const {
+  _scan(text.data(), text.size(), [&callback](const match& m) {
+    callback(m);
+    return true;
+  });
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+std::vector<typename basic_matcher<CharT, Traits, Allocator, RefCount>::match>
+basic_matcher<CharT, Traits, Allocator, RefCount>::find_all(
+    const string_type& text) const {
+  std::vector<match> matches;
+  for_each_match(text, [&matches](const match& m) { matches.push_back(m); });
+  return matches;
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+bool basic_matcher<CharT, Traits, Allocator, RefCount>::contains_any(
+    const string_type& text) const {
+  return !_scan(text.data(), text.size(), [](const match&) { return false; });
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+std::size_t basic_matcher<CharT, Traits, Allocator, RefCount>::_class(
+    CharT ch, std::false_type) const noexcept {
+  const auto it = std::lower_bound(m_alphabet.begin(), m_alphabet.end(), ch,
+                                   &Traits::lt);
+  if (it == m_alphabet.end() || !Traits::eq(*it, ch)) return 0;
+  return it - m_alphabet.begin() + 1;
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_matcher<CharT, Traits, Allocator, RefCount>::state_type
+basic_matcher<CharT, Traits, Allocator, RefCount>::_add_state() {
+  const auto state = m_output.size();
+  if (state >= none) throw std::length_error("basic_matcher");
+  m_next.resize(m_next.size() + m_classes, none);
+  m_output.push_back(none);
+  m_dictionary.push_back(none);
+  return static_cast<state_type>(state);
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+void basic_matcher<CharT, Traits, Allocator, RefCount>::_build_alphabet() {
+  for (const auto& pattern : m_patterns) {
+    m_alphabet.insert(m_alphabet.end(), pattern.begin(), pattern.end());
+  }
+  std::sort(m_alphabet.begin(), m_alphabet.end(), &Traits::lt);
+  m_alphabet.erase(
+      std::unique(m_alphabet.begin(), m_alphabet.end(), &Traits::eq),
+      m_alphabet.end());
+  m_classes = m_alphabet.size() + 1;
+
+  if (searchable::value) {
+    m_byte_class.assign(256, 0);
+    for (std::size_t i = 0; i < m_alphabet.size(); ++i) {
+      m_byte_class[static_cast<unsigned char>(m_alphabet[i])] =
+          static_cast<std::uint16_t>(i + 1);
+    }
+  }
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+void basic_matcher<CharT, Traits, Allocator, RefCount>::_build_trie() {
+  _add_state();
+  m_same.assign(m_patterns.size(), none);
+  std::size_t starts = 0;
+  for (std::size_t index = 0; index < m_patterns.size(); ++index) {
+    const auto& pattern = m_patterns[index];
+    if (pattern.empty()) continue;
+
+    state_type state = 0;
+    for (const auto ch : pattern) {
+      const auto transition = state * m_classes + _class(ch);
+      if (m_next[transition] == none) {
+        if (state == 0) ++starts;
+        const auto next = _add_state();
+        m_next[transition] = next;
+      }
+      state = m_next[transition];
+    }
+    m_same[index] = m_output[state];
+    m_output[state] = static_cast<state_type>(index);
+
+    m_start = pattern[0];
+  }
+  m_single_start = starts == 1;
+}
+
+// Links every state to its longest proper suffix in the trie and turns the
+// trie into a complete transition table, breadth-first, so that the suffix
+// of a state is complete before the state itself.
+template <class CharT, class Traits, class Allocator, class RefCount>
+void basic_matcher<CharT, Traits, Allocator, RefCount>::_link() {
+  std::vector<state_type> suffix(m_output.size(), 0);
+  std::vector<state_type> queue;
+  queue.reserve(m_output.size());
+
+  for (std::size_t c = 0; c < m_classes; ++c) {
+    auto& next = m_next[c];
+    if (next == none) {
+      next = 0;
+    } else {
+      queue.push_back(next);
+    }
+  }
+
+  for (std::size_t i = 0; i < queue.size(); ++i) {
+    const auto state = queue[i];
+    const auto row = state * m_classes;
+    const auto suffix_row = suffix[state] * m_classes;
+    for (std::size_t c = 0; c < m_classes; ++c) {
+      const auto fallback = m_next[suffix_row + c];
+      const auto next = m_next[row + c];
+      if (next == none) {
+        m_next[row + c] = fallback;
+        continue;
+      }
+      suffix[next] = fallback;
+      m_dictionary[next] =
+          m_output[fallback] != none ? fallback : m_dictionary[fallback];
+      queue.push_back(next);
+    }
+  }
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+template <class Visitor>
+bool basic_matcher<CharT, Traits, Allocator, RefCount>::_scan(
+    const CharT* s, size_type n, Visitor visit) const {
+  state_type state = 0;
+  for (size_type i = 0; i < n; ++i) {
+    if (state == 0 && m_single_start) {
+      const auto skipped = string_type::_find(s + i, n - i, m_start,
+                                              searchable{});
+      if (skipped == string_type::npos) return true;
+      i += skipped;
+    }
+
+    state = m_next[state * m_classes + _class(s[i])];
+    auto output = m_output[state] != none ? state : m_dictionary[state];
+    for (; output != none; output = m_dictionary[output]) {
+      for (auto index = m_output[output]; index != none;
+           index = m_same[index]) {
+        if (!visit(match{index, i + 1 - m_patterns[index].size()})) {
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+}  // namespace immutable_string
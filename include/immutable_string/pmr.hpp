@@ -0,0 +1,36 @@
+#pragma once
+
+#if __cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+#if defined(__has_include)
+#if __has_include(<memory_resource>)
+#define IMMUTABLE_STRING_HAS_PMR 1
+#endif
+#endif
+#endif
+
+#if defined(IMMUTABLE_STRING_HAS_PMR)
+
+#include <memory_resource>
+
+#include "string.hpp"
+
+namespace immutable_string {
+namespace pmr {
+
+// Strings taking memory from a std::pmr::memory_resource chosen at runtime.
+// The resource is kept in the header of heap strings, next to the
+// characters, so strings stay one pointer wide and inline ones store none.
+template <class CharT, class Traits = std::char_traits<CharT>,
+          class RefCount = atomic_refcount>
+using basic_string =
+    immutable_string::basic_string<CharT, Traits,
+                                   std::pmr::polymorphic_allocator<CharT>,
+                                   RefCount>;
+
+using string = basic_string<char>;
+using wstring = basic_string<wchar_t>;
+
+}  // namespace pmr
+}  // namespace immutable_string
+
+#endif  // IMMUTABLE_STRING_HAS_PMR
@@ -0,0 +1,322 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "string.hpp"
+
+namespace immutable_string {
+
+// Pool of small blocks in size classes fitting string buffers, from 16 bytes
+// to max_size in steps growing with the size. Each thread allocates from and
+// frees to free lists of its own; when one runs empty or grows too long, a
+// batch of blocks is moved from or to shared lists under a lock, so blocks
+// freed by other threads come back in batches. Memory is taken from the
+// system in slabs and kept for reuse.
+class buffer_pool {
+ public:
+  static const std::size_t max_size = 1024;
+  static const std::size_t alignment = 16;
+
+  struct statistics {
+    std::size_t allocations = 0;
+    // allocations served by the free lists of the thread
+    std::size_t hits = 0;
+    // batches moved to the thread from the shared lists or a slab
+    std::size_t refills = 0;
+    std::size_t slabs = 0;
+    // allocations larger than max_size, passed on to operator new
+    std::size_t large = 0;
+
+    double hit_rate() const noexcept {
+      return allocations == 0 ? 0 : static_cast<double>(hits) / allocations;
+    }
+  };
+
+  static void* allocate(std::size_t size);
+  static void deallocate(void* p, std::size_t size) noexcept;
+
+  // Counts of other threads are included as of their last refill or flush.
+  static statistics stats() noexcept;
+  // Moves the blocks cached by the calling thread to the shared lists.
+  static void flush() noexcept;
+
+ private:
+  static const std::size_t class_count = 20;
+  static const std::size_t slab_size = 64 * 1024;
+
+  struct block {
+    block* next;
+    // links chains of blocks in the shared lists
+    block* next_chain;
+  };
+  struct shared_list {
+    std::mutex mutex;
+    block* chains = nullptr;
+    char* free_begin = nullptr;
+    char* free_end = nullptr;
+  };
+  struct shared_state {
+    shared_list lists[class_count];
+    std::mutex slabs_mutex;
+    std::vector<void*> slabs;
+    std::atomic<std::size_t> allocations{0};
+    std::atomic<std::size_t> hits{0};
+    std::atomic<std::size_t> refills{0};
+    std::atomic<std::size_t> large{0};
+  };
+  struct local_list {
+    block* head = nullptr;
+    std::size_t count = 0;
+  };
+  struct thread_cache {
+    explicit thread_cache(bool& destroyed_flag) noexcept
+        : destroyed(destroyed_flag) {}
+    ~thread_cache();
+
+    bool& destroyed;
+    local_list lists[class_count];
+    std::size_t allocations = 0;
+    std::size_t hits = 0;
+  };
+
+  // classes grow by 16 bytes up to 128, then by 32, 64 and 128
+  static std::size_t _class(std::size_t size) noexcept {
+    if (size <= 128) return size == 0 ? 0 : (size - 1) / 16;
+    if (size <= 256) return 8 + (size - 129) / 32;
+    if (size <= 512) return 12 + (size - 257) / 64;
+    return 16 + (size - 513) / 128;
+  }
+  static std::size_t _class_size(std::size_t index) noexcept {
+    if (index < 8) return (index + 1) * 16;
+    if (index < 12) return 128 + (index - 7) * 32;
+    if (index < 16) return 256 + (index - 11) * 64;
+    return 512 + (index - 15) * 128;
+  }
+  static std::size_t _batch(std::size_t index) noexcept {
+    return std::max<std::size_t>(4, 4096 / _class_size(index));
+  }
+
+  static shared_state& _shared() noexcept {
+    // never destroyed, so that strings may be freed during static
+    // destruction
+    static shared_state& state = *new shared_state;
+    return state;
+  }
+  static thread_cache* _local() noexcept {
+    // trivially destructible, so it may be read after the cache is destroyed
+    static thread_local bool destroyed = false;
+    if (destroyed) return nullptr;
+    static thread_local thread_cache cache(destroyed);
+    return &cache;
+  }
+
+  static block* _take_chain(std::size_t index);
+  static void _put_chain(std::size_t index, block* head) noexcept;
+  static void _flush(std::size_t index, local_list& list,
+                     std::size_t count) noexcept;
+  static void _publish(thread_cache& cache) noexcept;
+};
+
+// Allocator taking small blocks from buffer_pool.
+template <class T>
+class pool_allocator {
+ public:
+  using value_type = T;
+  using pointer = T*;
+  using const_pointer = const T*;
+  using reference = T&;
+  using const_reference = const T&;
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+
+  template <class U>
+  struct rebind {
+    using other = pool_allocator<U>;
+  };
+
+  pool_allocator() noexcept = default;
+  template <class U>
+  pool_allocator(const pool_allocator<U>&) noexcept {}
+
+  T* allocate(std::size_t n) {
+    static_assert(alignof(T) <= buffer_pool::alignment,
+                  "pool blocks are aligned to buffer_pool::alignment");
+    if (n > std::size_t(-1) / sizeof(T)) throw std::bad_alloc();
+    return static_cast<T*>(buffer_pool::allocate(n * sizeof(T)));
+  }
+  void deallocate(T* p, std::size_t n) noexcept {
+    buffer_pool::deallocate(p, n * sizeof(T));
+  }
+};
+
+template <class T, class U>
+bool operator==(const pool_allocator<T>&, const pool_allocator<U>&) noexcept {
+  return true;
+}
+template <class T, class U>
+bool operator!=(const pool_allocator<T>&, const pool_allocator<U>&) noexcept {
+  return false;
+}
+
+template <class CharT, class Traits = std::char_traits<CharT>,
+          class RefCount = atomic_refcount>
+using basic_pooled_string =
+    basic_string<CharT, Traits, pool_allocator<CharT>, RefCount>;
+
+using pooled_string = basic_pooled_string<char>;
+using pooled_wstring = basic_pooled_string<wchar_t>;
+
+inline void* buffer_pool::allocate(std::size_t size) {
+  const auto cache = _local();
+  if (size > max_size) {
+    if (cache) {
+      ++cache->allocations;
+    } else {
+      _shared().allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    _shared().large.fetch_add(1, std::memory_order_relaxed);
+    return ::operator new(size);
+  }
+
+  const auto index = _class(size);
+  if (!cache) {
+    _shared().allocations.fetch_add(1, std::memory_order_relaxed);
+    const auto result = _take_chain(index);
+    if (result->next) _put_chain(index, result->next);
+    return result;
+  }
+
+  ++cache->allocations;
+  auto& list = cache->lists[index];
+  if (list.head) {
+    ++cache->hits;
+  } else {
+    list.head = _take_chain(index);
+    for (auto it = list.head; it; it = it->next) ++list.count;
+    _publish(*cache);
+  }
+  const auto result = list.head;
+  list.head = result->next;
+  --list.count;
+  return result;
+}
+
+inline void buffer_pool::deallocate(void* p, std::size_t size) noexcept {
+  if (size > max_size) {
+    ::operator delete(p);
+    return;
+  }
+
+  const auto index = _class(size);
+  const auto freed = ::new (p) block{nullptr, nullptr};
+  const auto cache = _local();
+  if (!cache) {
+    _put_chain(index, freed);
+    return;
+  }
+
+  auto& list = cache->lists[index];
+  freed->next = list.head;
+  list.head = freed;
+  const auto batch = _batch(index);
+  if (++list.count >= 2 * batch) _flush(index, list, batch);
+}
+
+inline buffer_pool::statistics buffer_pool::stats() noexcept {
+  if (const auto cache = _local()) _publish(*cache);
+  auto& shared = _shared();
+  statistics result;
+  result.allocations = shared.allocations.load(std::memory_order_relaxed);
+  result.hits = shared.hits.load(std::memory_order_relaxed);
+  result.refills = shared.refills.load(std::memory_order_relaxed);
+  result.large = shared.large.load(std::memory_order_relaxed);
+  std::lock_guard<std::mutex> lock(shared.slabs_mutex);
+  result.slabs = shared.slabs.size();
+  return result;
+}
+
+inline void buffer_pool::flush() noexcept {
+  const auto cache = _local();
+  if (!cache) return;
+  for (std::size_t i = 0; i < class_count; ++i) {
+    _flush(i, cache->lists[i], cache->lists[i].count);
+  }
+  _publish(*cache);
+}
+
+// Returns a chain of blocks of the class, carving a new one if there is none.
+inline buffer_pool::block* buffer_pool::_take_chain(std::size_t index) {
+  auto& shared = _shared();
+  auto& list = shared.lists[index];
+  shared.refills.fetch_add(1, std::memory_order_relaxed);
+  std::lock_guard<std::mutex> lock(list.mutex);
+  if (const auto chain = list.chains) {
+    list.chains = chain->next_chain;
+    return chain;
+  }
+
+  const auto size = _class_size(index);
+  const auto count = _batch(index);
+  if (static_cast<std::size_t>(list.free_end - list.free_begin) <
+      size * count) {
+    const auto slab = static_cast<char*>(::operator new(slab_size));
+    {
+      std::lock_guard<std::mutex> slabs_lock(shared.slabs_mutex);
+      shared.slabs.push_back(slab);
+    }
+    list.free_begin = slab;
+    list.free_end = slab + slab_size;
+  }
+
+  block* head = nullptr;
+  for (std::size_t i = 0; i < count; ++i) {
+    list.free_end -= size;
+    head = ::new (list.free_end) block{head, nullptr};
+  }
+  return head;
+}
+
+inline void buffer_pool::_put_chain(std::size_t index, block* head) noexcept {
+  auto& list = _shared().lists[index];
+  std::lock_guard<std::mutex> lock(list.mutex);
+  head->next_chain = list.chains;
+  list.chains = head;
+}
+
+// Moves the first `count` blocks of the list to the shared lists.
+inline void buffer_pool::_flush(std::size_t index, local_list& list,
+                                std::size_t count) noexcept {
+  if (count == 0) return;
+  const auto head = list.head;
+  auto last = head;
+  for (std::size_t i = 1; i < count; ++i) last = last->next;
+  list.head = last->next;
+  list.count -= count;
+  last->next = nullptr;
+  _put_chain(index, head);
+}
+
+inline void buffer_pool::_publish(thread_cache& cache) noexcept {
+  auto& shared = _shared();
+  shared.allocations.fetch_add(cache.allocations, std::memory_order_relaxed);
+  shared.hits.fetch_add(cache.hits, std::memory_order_relaxed);
+  cache.allocations = 0;
+  cache.hits = 0;
+}
+
+inline buffer_pool::thread_cache::~thread_cache() {
+  for (std::size_t i = 0; i < class_count; ++i) {
+    _flush(i, lists[i], lists[i].count);
+  }
+  _publish(*this);
+  destroyed = true;
+}
+
+}  // namespace immutable_string
@@ -0,0 +1,441 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace immutable_string {
+
+// Reference counting policies for basic_string.
+//
+// A policy provides a nested counter class, which is stored in the header of
+// every heap string and starts with one reference:
+//   counter(void (*destroy)(counter*))
+//       `destroy` frees the string owning the counter; a policy calls it when
+//       the last reference is dropped somewhere other than release(). Null for
+//       literals, which are never counted: the constructor shall then be a
+//       constant expression, so that literals are constant-initialized.
+//   void acquire() noexcept
+//   bool release() noexcept  // true if the caller dropped the last reference
+//   std::size_t use_count() const noexcept
+// and `is_thread_safe`, telling whether strings may be shared across threads,
+// `has_exact_use_count`, telling whether use_count() is the number of
+// references at some instant, which facilities dropping unreferenced strings
+// rely on, and `frees_strings`, telling whether a string is freed once no
+// longer referenced, which adopted buffers rely on to run their deleters.
+
+// Thread-safe reference counting with a single atomic counter (default).
+struct atomic_refcount {
+  static constexpr bool is_thread_safe = true;
+  static constexpr bool has_exact_use_count = true;
+  static constexpr bool frees_strings = true;
+
+  class counter {
+   public:
+    constexpr explicit counter(void (*)(counter*)) noexcept : m_refs(1) {}
+
+    void acquire() noexcept { m_refs.fetch_add(1, std::memory_order_relaxed); }
+    bool release() noexcept {
+      return m_refs.fetch_sub(1, std::memory_order_acq_rel) == 1;
+    }
+    std::size_t use_count() const noexcept {
+      return m_refs.load(std::memory_order_relaxed);
+    }
+
+   private:
+    std::atomic<std::size_t> m_refs;
+  };
+};
+
+// Plain counter for strings which never leave the thread that created them.
+// Strings using it are not thread-safe; facilities which share strings
+// between threads reject them at compile time.
+struct nonatomic_refcount {
+  static constexpr bool is_thread_safe = false;
+  static constexpr bool has_exact_use_count = true;
+  static constexpr bool frees_strings = true;
+
+  class counter {
+   public:
+    constexpr explicit counter(void (*)(counter*)) noexcept : m_refs(1) {}
+
+    void acquire() noexcept { ++m_refs; }
+    bool release() noexcept { return --m_refs == 0; }
+    std::size_t use_count() const noexcept { return m_refs; }
+
+   private:
+    std::size_t m_refs;
+  };
+};
+
+// No counting at all, for strings whose memory is released in bulk, such as
+// arena strings: they are never freed one by one, and copying or destroying
+// them touches nothing but the string itself. use_count() is 0, unknown.
+struct uncounted_refcount {
+  static constexpr bool is_thread_safe = true;
+  static constexpr bool has_exact_use_count = false;
+  static constexpr bool frees_strings = false;
+
+  class counter {
+   public:
+    constexpr explicit counter(void (*)(counter*)) noexcept {}
+
+    void acquire() noexcept {}
+    bool release() noexcept { return false; }
+    std::size_t use_count() const noexcept { return 0; }
+  };
+};
+
+// Biased reference counting: the thread that created a string updates its
+// own counter without atomic read-modify-writes, other threads update a shared
+// atomic one. When the owner drops its last reference the counters are merged
+// and the shared one decides from then on. If other threads drop more
+// references than they took, the string is queued to its owner, which merges
+// it on its next biased operation, on collect() or when it exits. Strings
+// made by a thread after it has exited, e.g. by destructors of statics, start
+// merged.
+// use_count() reads the two counters one after the other, so it may be off
+// while other threads copy the string.
+class biased_refcount {
+  struct thread_queue;
+
+ public:
+  static constexpr bool is_thread_safe = true;
+  static constexpr bool has_exact_use_count = false;
+  static constexpr bool frees_strings = true;
+
+  class counter {
+   public:
+    constexpr explicit counter(void (*destroy)(counter*)) noexcept
+        : counter(destroy ? _own() : nullptr, destroy) {}
+
+    void acquire() noexcept;
+    bool release() noexcept;
+    std::size_t use_count() const noexcept;
+
+   private:
+    friend class biased_refcount;
+
+    constexpr counter(thread_queue* owner, void (*destroy)(counter*)) noexcept
+        : m_owner(owner),
+          m_biased(owner ? 1 : 0),
+          m_shared(owner ? 0 : one | merged),
+          m_destroy(destroy) {}
+
+    // m_shared holds the count of the other threads multiplied by `one`, so
+    // that it may go negative, plus the following flags
+    static constexpr std::intptr_t merged = 1;
+    static constexpr std::intptr_t queued = 2;
+    static constexpr std::intptr_t one = 4;
+
+    static std::intptr_t _count(std::intptr_t shared) noexcept {
+      return (shared - (shared & (merged | queued))) / one;
+    }
+    bool _is_owned_by(thread_queue* queue) const noexcept {
+      // only the owner merges while it is alive, so it reads its own flag
+      return m_owner == queue &&
+             !(m_shared.load(std::memory_order_relaxed) & merged);
+    }
+    bool _try_merge() noexcept;
+    bool _merge() noexcept;
+
+    // stays valid while the counter is not merged
+    thread_queue* const m_owner;
+    // written by the owner only, atomic just to be readable by others
+    std::atomic<std::size_t> m_biased;
+    std::atomic<std::intptr_t> m_shared;
+    void (*m_destroy)(counter*);
+  };
+
+  // Merges strings queued to the calling thread, freeing unreferenced ones.
+  static void collect() noexcept {
+    if (const auto local = _local()) _collect(local);
+  }
+
+ private:
+  struct thread_queue {
+    std::mutex mutex;
+    std::vector<counter*> pending;
+    std::atomic<bool> has_pending{false};
+    bool alive = true;
+    // the owning thread and every unmerged counter it created
+    std::atomic<std::size_t> users{1};
+
+    // Returns false if the owner has exited; the caller merges the counter.
+    bool push(counter* c);
+    void unuse() noexcept {
+      if (users.fetch_sub(1, std::memory_order_acq_rel) == 1) delete this;
+    }
+  };
+
+  struct thread_holder {
+    thread_queue* queue = new thread_queue;
+    ~thread_holder();
+  };
+
+  // Trivially destructible, so that it stays readable while other
+  // thread_local and static strings are destroyed after the holder.
+  static bool& _closed() noexcept {
+    static thread_local bool closed;
+    return closed;
+  }
+  // null once the holder of the thread is destroyed
+  static thread_queue* _local() noexcept {
+    if (_closed()) return nullptr;
+    static thread_local thread_holder holder;
+    return holder.queue;
+  }
+  // the queue of a new counter, null once the thread has exited
+  static thread_queue* _own() noexcept {
+    const auto local = _local();
+    if (local) local->users.fetch_add(1, std::memory_order_relaxed);
+    return local;
+  }
+  static void _collect(thread_queue* queue) noexcept;
+};
+
+// Deferred reference counting: each thread counts its copies of a string in a
+// small table of its own, without atomic read-modify-writes, and adds them to
+// the shared counter in batches: when the table slot is taken by another
+// string, on flush() or when the thread exits. Copies of a string shared by
+// many threads thus touch no common cache line. The shared counter also
+// counts the threads holding unflushed counts, so that it drops to zero only
+// once every count is added. A string whose last reference is dropped while
+// another thread holds an unflushed count is freed by that thread's flush;
+// each thread delays freeing at most `table_size` strings this way.
+// use_count() misses the unflushed counts of other threads.
+class deferred_refcount {
+ public:
+  static constexpr bool is_thread_safe = true;
+  static constexpr bool has_exact_use_count = false;
+  static constexpr bool frees_strings = true;
+  static constexpr std::size_t table_size = 16;
+
+  class counter {
+   public:
+    constexpr explicit counter(void (*destroy)(counter*)) noexcept
+        : m_shared(1), m_destroy(destroy) {}
+
+    void acquire() noexcept;
+    bool release() noexcept;
+    std::size_t use_count() const noexcept;
+
+   private:
+    friend class deferred_refcount;
+
+    // m_shared holds the added count in its low half, which may go negative,
+    // and the number of threads holding unflushed counts in its high half
+    static constexpr std::int64_t one_thread = std::int64_t{1} << 32;
+
+    // true if the shared counter dropped to zero
+    bool _add(std::int64_t delta) noexcept {
+      return m_shared.fetch_add(delta, std::memory_order_acq_rel) == -delta;
+    }
+
+    std::atomic<std::int64_t> m_shared;
+    void (*m_destroy)(counter*);
+  };
+
+  // Adds the counts of the calling thread to the shared counters, freeing
+  // strings it held the last references to.
+  static void flush() noexcept;
+
+ private:
+  struct entry {
+    counter* refs;
+    std::int64_t count;
+  };
+  // Trivially destructible, so that it stays usable while other thread_local
+  // strings are destroyed; counts are not deferred once it is closed.
+  struct thread_table {
+    entry entries[table_size];
+    bool closed;
+  };
+  struct thread_flusher {
+    ~thread_flusher() {
+      flush();
+      _table().closed = true;
+    }
+  };
+
+  static thread_table& _table() noexcept {
+    static thread_local thread_table table;
+    return table;
+  }
+  static entry& _slot(thread_table& table, const counter* c) noexcept {
+    const auto address = reinterpret_cast<std::uintptr_t>(c);
+    return table.entries[address / alignof(counter) % table_size];
+  }
+  static void _open(entry& slot, counter* c) noexcept;
+  static void _flush(entry old) noexcept {
+    if (old.refs->_add(old.count - counter::one_thread)) {
+      old.refs->m_destroy(old.refs);
+    }
+  }
+};
+
+inline void biased_refcount::counter::acquire() noexcept {
+  const auto local = _local();
+  if (!_is_owned_by(local)) {
+    m_shared.fetch_add(one, std::memory_order_relaxed);
+    return;
+  }
+  m_biased.store(m_biased.load(std::memory_order_relaxed) + 1,
+                 std::memory_order_relaxed);
+  if (local->has_pending.load(std::memory_order_relaxed)) _collect(local);
+}
+
+inline bool biased_refcount::counter::release() noexcept {
+  const auto local = _local();
+  if (_is_owned_by(local)) {
+    const auto biased = m_biased.load(std::memory_order_relaxed) - 1;
+    m_biased.store(biased, std::memory_order_relaxed);
+    // merging may free the queue of an exiting thread, so it is not
+    // touched afterwards; pending strings wait for the next operation
+    if (biased == 0) return _try_merge();
+    if (local->has_pending.load(std::memory_order_relaxed)) _collect(local);
+    return false;
+  }
+
+  auto shared = m_shared.load(std::memory_order_relaxed);
+  std::intptr_t next;
+  bool enqueue;
+  do {
+    next = shared - one;
+    enqueue = !(shared & (merged | queued)) && next < 0;
+    if (enqueue) next |= queued;
+  } while (!m_shared.compare_exchange_weak(shared, next,
+                                           std::memory_order_acq_rel,
+                                           std::memory_order_relaxed));
+
+  if (enqueue) return !m_owner->push(this) && _merge();
+  return (next & merged) && _count(next) == 0;
+}
+
+inline std::size_t biased_refcount::counter::use_count() const noexcept {
+  const auto shared = m_shared.load(std::memory_order_acquire);
+  return m_biased.load(std::memory_order_relaxed) +
+         static_cast<std::size_t>(_count(shared));
+}
+
+// Called by the owner once it holds no references. A queued counter is left
+// for _collect, which already has it in the queue. Once merged, the counter
+// may be freed by another thread at any moment, so it is not touched again.
+inline bool biased_refcount::counter::_try_merge() noexcept {
+  const auto owner = m_owner;
+  auto shared = m_shared.load(std::memory_order_relaxed);
+  do {
+    if (shared & queued) return false;
+  } while (!m_shared.compare_exchange_weak(shared, shared | merged,
+                                           std::memory_order_acq_rel,
+                                           std::memory_order_relaxed));
+  owner->unuse();
+  return _count(shared) == 0;
+}
+
+// Called for a queued counter by the owner, or by any thread once the owner
+// has exited.
+inline bool biased_refcount::counter::_merge() noexcept {
+  const auto owner = m_owner;
+  const auto biased =
+      static_cast<std::intptr_t>(m_biased.load(std::memory_order_relaxed));
+  m_biased.store(0, std::memory_order_relaxed);
+  const auto shared =
+      m_shared.fetch_add(biased * one + merged, std::memory_order_acq_rel);
+  owner->unuse();
+  return _count(shared) + biased == 0;
+}
+
+inline void biased_refcount::_collect(thread_queue* queue) noexcept {
+  std::vector<counter*> pending;
+  {
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    pending.swap(queue->pending);
+    queue->has_pending.store(false, std::memory_order_relaxed);
+  }
+  for (const auto c : pending) {
+    if (c->_merge()) c->m_destroy(c);
+  }
+}
+
+inline bool biased_refcount::thread_queue::push(counter* c) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!alive) return false;
+  pending.push_back(c);
+  has_pending.store(true, std::memory_order_relaxed);
+  return true;
+}
+
+// The queue is closed and emptied under one lock, so that every counter is
+// either merged here or, pushed later, by the thread releasing it.
+inline biased_refcount::thread_holder::~thread_holder() {
+  std::vector<counter*> pending;
+  {
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    queue->alive = false;
+    pending.swap(queue->pending);
+    queue->has_pending.store(false, std::memory_order_relaxed);
+  }
+  for (const auto c : pending) {
+    if (c->_merge()) c->m_destroy(c);
+  }
+  _closed() = true;
+  queue->unuse();
+}
+
+inline void deferred_refcount::counter::acquire() noexcept {
+  auto& table = _table();
+  auto& slot = _slot(table, this);
+  if (slot.refs == this) {
+    ++slot.count;
+  } else if (table.closed) {
+    m_shared.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    _open(slot, this);
+  }
+}
+
+// Dropping a reference never opens a slot: a string that was not copied by
+// the thread is released at once.
+inline bool deferred_refcount::counter::release() noexcept {
+  auto& slot = _slot(_table(), this);
+  if (slot.refs != this) return _add(-1);
+  --slot.count;
+  return false;
+}
+
+inline std::size_t deferred_refcount::counter::use_count() const noexcept {
+  const auto shared = m_shared.load(std::memory_order_acquire);
+  const auto threads = (shared + one_thread / 2) / one_thread;
+  auto count = shared - threads * one_thread;
+  const auto& slot = _slot(_table(), this);
+  if (slot.refs == this) count += slot.count;
+  return count > 0 ? static_cast<std::size_t>(count) : 0;
+}
+
+// Takes the slot for a string copied by the thread, flushing the string in it.
+inline void deferred_refcount::_open(entry& slot, counter* c) noexcept {
+  static thread_local thread_flusher flusher;
+  (void)flusher;
+  c->m_shared.fetch_add(counter::one_thread, std::memory_order_relaxed);
+  const auto old = slot;
+  slot = entry{c, 1};
+  // freeing the old string may release others, so the slot is set by now
+  if (old.refs) _flush(old);
+}
+
+inline void deferred_refcount::flush() noexcept {
+  auto& table = _table();
+  entry entries[table_size];
+  for (std::size_t i = 0; i < table_size; ++i) {
+    entries[i] = table.entries[i];
+    table.entries[i] = entry{nullptr, 0};
+  }
+  for (const auto& old : entries) {
+    if (old.refs) _flush(old);
+  }
+}
+
+}  // namespace immutable_string
@@ -0,0 +1,555 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "builder.hpp"
+#include "string.hpp"
+
+namespace immutable_string {
+
+// Text kept as a balanced tree of immutable strings, so that versions derived
+// by slicing, concatenating, inserting or erasing share every chunk they did
+// not change:
+//   const rope document{load(path)};
+//   const auto edited = document.replace(pos, count, rope{"new text"});
+// Those and indexing take O(log n) in the number of chunks, which are cut
+// with substr() and so share their characters too. Small adjacent chunks are
+// merged. str() flattens the text into a single string. Nodes are never
+// modified and are shared with std::shared_ptr.
+template <class CharT, class Traits = std::char_traits<CharT>,
+          class Allocator = std::allocator<CharT>,
+          class RefCount = atomic_refcount>
+class basic_rope {
+ public:
+  using string_type = basic_string<CharT, Traits, Allocator, RefCount>;
+  using traits_type = Traits;
+  using value_type = CharT;
+  using allocator_type = Allocator;
+  using size_type = typename string_type::size_type;
+  using const_reference = typename string_type::const_reference;
+
+  static const size_type npos = -1;
+  // adjacent chunks are merged while the result is at most this long
+  static const size_type merge_size = 128;
+
+  explicit basic_rope(const Allocator& alloc = Allocator()) noexcept
+      : m_alloc(alloc) {}
+  basic_rope(string_type str, const Allocator& alloc = Allocator());
+  basic_rope(const CharT* s, const Allocator& alloc = Allocator())
+      : basic_rope(string_type(s, alloc), alloc) {}
+
+  bool empty() const noexcept { return size() == 0; }
+  size_type size() const noexcept { return m_root ? m_root->size : 0; }
+  size_type length() const noexcept { return size(); }
+
+  const_reference operator[](size_type pos) const noexcept;
+  const_reference at(size_type pos) const;
+
+  // Derived ropes, sharing the chunks of this one.
+  basic_rope substr(size_type pos = 0, size_type count = npos) const;
+  basic_rope append(const basic_rope& rope) const;
+  basic_rope insert(size_type pos, const basic_rope& rope) const;
+  basic_rope erase(size_type pos = 0, size_type count = npos) const;
+  basic_rope replace(size_type pos, size_type count,
+                     const basic_rope& rope) const;
+
+  size_type find(const string_type& str, size_type pos = 0) const;
+  size_type find(const CharT* s, size_type pos, size_type count) const;
+  size_type find(const CharT* s, size_type pos = 0) const;
+  size_type find(CharT ch, size_type pos = 0) const;
+
+  int compare(const basic_rope& rope) const noexcept;
+  int compare(const string_type& str) const noexcept;
+  int compare(const CharT* s) const noexcept;
+
+  // Calls f(data, size) for every chunk, in order.
+  template <class F>
+  void for_each_chunk(F f) const;
+  // The characters as one string; a single chunk is returned as it is.
+  string_type str() const;
+
+ private:
+  void _throw_out_of_range() const { throw std::out_of_range("basic_rope"); }
+
+  struct node;
+  using node_ptr = std::shared_ptr<const node>;
+  // Leaves hold a chunk, inner nodes two children of heights differing by
+  // at most one.
+  struct node {
+    explicit node(string_type chars) noexcept
+        : size(chars.size()), height(0), leaf(std::move(chars)) {}
+    node(node_ptr left_child, node_ptr right_child) noexcept
+        : size(left_child->size + right_child->size),
+          height(1 + std::max(left_child->height, right_child->height)),
+          left(std::move(left_child)),
+          right(std::move(right_child)) {}
+
+    size_type size;
+    int height;
+    string_type leaf;
+    node_ptr left;
+    node_ptr right;
+  };
+  // Visits the leaves in order from a position on, keeping the right
+  // subtrees left to visit, one per level at most: a tree whose siblings
+  // differ in height by one at most has fewer than 2^64 leaves below this
+  // height.
+  class leaf_cursor {
+   public:
+    leaf_cursor(const node* root, size_type pos) noexcept {
+      if (root) _descend(root, pos);
+    }
+
+    // null past the last leaf
+    const string_type* leaf() const noexcept { return m_leaf; }
+    // first character to visit, zero but in the first leaf
+    size_type begin() const noexcept { return m_begin; }
+    void next() noexcept {
+      m_leaf = nullptr;
+      if (m_pending_count != 0) _descend(m_pending[--m_pending_count], 0);
+    }
+
+   private:
+    static const int max_height = 96;
+
+    void _descend(const node* n, size_type pos) noexcept {
+      while (n->height != 0) {
+        if (pos < n->left->size) {
+          m_pending[m_pending_count++] = n->right.get();
+          n = n->left.get();
+        } else {
+          pos -= n->left->size;
+          n = n->right.get();
+        }
+      }
+      m_leaf = &n->leaf;
+      m_begin = pos;
+    }
+
+    const node* m_pending[max_height];
+    int m_pending_count = 0;
+    const string_type* m_leaf = nullptr;
+    size_type m_begin = 0;
+  };
+
+  basic_rope(node_ptr root, const Allocator& alloc) noexcept
+      : m_alloc(alloc), m_root(std::move(root)) {}
+
+  node_ptr _leaf(string_type chars) const;
+  node_ptr _inner(node_ptr left, node_ptr right) const;
+  node_ptr _balance(const node_ptr& left, const node_ptr& right) const;
+  node_ptr _join(const node_ptr& left, const node_ptr& right) const;
+  node_ptr _slice(const node_ptr& n, size_type begin, size_type end) const;
+  template <class F>
+  static bool _for_each_chunk(const node* n, F& f);
+  int _compare(const CharT* s, size_type count) const noexcept;
+
+  Allocator m_alloc;
+  // null for empty ropes, which is the only place an empty chunk could be
+  node_ptr m_root;
+};
+
+using rope = basic_rope<char>;
+using wrope = basic_rope<wchar_t>;
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+const typename basic_rope<CharT, Traits, Allocator, RefCount>::size_type
+    basic_rope<CharT, Traits, Allocator, RefCount>::npos;
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+const typename basic_rope<CharT, Traits, Allocator, RefCount>::size_type
+    basic_rope<CharT, Traits, Allocator, RefCount>::merge_size;
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+basic_rope<CharT, Traits, Allocator, RefCount>::basic_rope(
+    string_type str, const Allocator& alloc)
+    : m_alloc(alloc) {
+  if (!str.empty()) m_root = _leaf(std::move(str));
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_rope<CharT, Traits, Allocator, RefCount>::const_reference
+basic_rope<CharT, Traits, Allocator, RefCount>::operator[](
+    size_type pos) const noexcept {
+  auto n = m_root.get();
+  while (n->height != 0) {
+    if (pos < n->left->size) {
+      n = n->left.get();
+    } else {
+      pos -= n->left->size;
+      n = n->right.get();
+    }
+  }
+  return n->leaf[pos];
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_rope<CharT, Traits, Allocator, RefCount>::const_reference
+basic_rope<CharT, Traits, Allocator, RefCount>::at(size_type pos) const {
+  if (pos >= size()) _throw_out_of_range();
+  return (*this)[pos];
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+basic_rope<CharT, Traits, Allocator, RefCount>
+basic_rope<CharT, Traits, Allocator, RefCount>::substr(size_type pos,
+                                                       size_type count) const {
+  if (pos > size()) _throw_out_of_range();
+  count = std::min(count, size() - pos);
+  if (count == 0) return basic_rope(m_alloc);
+  return basic_rope(_slice(m_root, pos, pos + count), m_alloc);
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+basic_rope<CharT, Traits, Allocator, RefCount>
+basic_rope<CharT, Traits, Allocator, RefCount>::append(
+    const basic_rope& rope) const {
+  return basic_rope(_join(m_root, rope.m_root), m_alloc);
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+basic_rope<CharT, Traits, Allocator, RefCount>
+basic_rope<CharT, Traits, Allocator, RefCount>::insert(
+    size_type pos, const basic_rope& rope) const {
+  return replace(pos, 0, rope);
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+basic_rope<CharT, Traits, Allocator, RefCount>
+basic_rope<CharT, Traits, Allocator, RefCount>::erase(size_type pos,
+                                                      size_type count) const {
+  return replace(pos, count, basic_rope(m_alloc));
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+basic_rope<CharT, Traits, Allocator, RefCount>
+basic_rope<CharT, Traits, Allocator, RefCount>::replace(
+    size_type pos, size_type count, const basic_rope& rope) const {
+  if (pos > size()) _throw_out_of_range();
+  count = std::min(count, size() - pos);
+  const auto prefix = substr(0, pos);
+  const auto suffix = substr(pos + count);
+  return basic_rope(_join(_join(prefix.m_root, rope.m_root), suffix.m_root),
+                    m_alloc);
+}
+
+// find
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_rope<CharT, Traits, Allocator, RefCount>::size_type
+basic_rope<CharT, Traits, Allocator, RefCount>::find(const string_type& str,
+                                                     size_type pos) const {
+  return find(str.data(), pos, str.size());
+}
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_rope<CharT, Traits, Allocator, RefCount>::size_type
+basic_rope<CharT, Traits, Allocator, RefCount>::find(const CharT* s,
+                                                     size_type pos) const {
+  return find(s, pos, Traits::length(s));
+}
+
+// Occurrences inside a chunk are searched for by the chunk itself. The ones
+// crossing into it from the chunks before start among the last count - 1
+// characters preceding it, so they are searched for in a window made of
+// those and the first count - 1 characters of the chunk.
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_rope<CharT, Traits, Allocator, RefCount>::size_type
+basic_rope<CharT, Traits, Allocator, RefCount>::find(const CharT* s,
+                                                     size_type pos,
+                                                     size_type count) const {
+  if (pos > size() || count > size() - pos) return npos;
+  if (count == 0) return pos;
+
+  std::basic_string<CharT, Traits> window;
+  for (leaf_cursor it(m_root.get(), pos); it.leaf(); it.next()) {
+    const auto& leaf = *it.leaf();
+    const auto begin = it.begin();
+    const auto length = leaf.size() - begin;
+
+    const auto before = window.size();
+    window.append(leaf.data() + begin, std::min(length, count - 1));
+    if (before != 0) {
+      const auto crossing = window.find(s, 0, count);
+      if (crossing < before) return pos - before + crossing;
+    }
+    const auto found = leaf.find(s, begin, count);
+    if (found != string_type::npos) return pos + (found - begin);
+
+    // a chunk shorter than that has been appended whole
+    if (length >= count - 1) {
+      window.assign(leaf.data() + leaf.size() - (count - 1), count - 1);
+    } else if (window.size() > count - 1) {
+      window.erase(0, window.size() - (count - 1));
+    }
+    pos += length;
+  }
+  return npos;
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_rope<CharT, Traits, Allocator, RefCount>::size_type
+basic_rope<CharT, Traits, Allocator, RefCount>::find(CharT ch,
+                                                     size_type pos) const {
+  if (pos >= size()) return npos;
+  for (leaf_cursor it(m_root.get(), pos); it.leaf(); it.next()) {
+    const auto found = it.leaf()->find(ch, it.begin());
+    if (found != string_type::npos) return pos + (found - it.begin());
+    pos += it.leaf()->size() - it.begin();
+  }
+  return npos;
+}
+
+// compare
+template <class CharT, class Traits, class Allocator, class RefCount>
+int basic_rope<CharT, Traits, Allocator, RefCount>::compare(
+    const basic_rope& rope) const noexcept {
+  if (m_root == rope.m_root) return 0;
+  leaf_cursor lhs(m_root.get(), 0);
+  leaf_cursor rhs(rope.m_root.get(), 0);
+
+  size_type lhs_pos = 0, rhs_pos = 0;
+  while (lhs.leaf() && rhs.leaf()) {
+    const auto& l = *lhs.leaf();
+    const auto& r = *rhs.leaf();
+    const auto count = std::min(l.size() - lhs_pos, r.size() - rhs_pos);
+    const auto res = Traits::compare(l.data() + lhs_pos, r.data() + rhs_pos,
+                                     count);
+    if (res != 0) return res;
+    lhs_pos += count;
+    rhs_pos += count;
+    if (lhs_pos == l.size()) lhs.next(), lhs_pos = 0;
+    if (rhs_pos == r.size()) rhs.next(), rhs_pos = 0;
+  }
+  return size() < rope.size() ? -1 : size() > rope.size() ? 1 : 0;
+}
+template <class CharT, class Traits, class Allocator, class RefCount>
+int basic_rope<CharT, Traits, Allocator, RefCount>::compare(
+    const string_type& str) const noexcept {
+  return _compare(str.data(), str.size());
+}
+template <class CharT, class Traits, class Allocator, class RefCount>
+int basic_rope<CharT, Traits, Allocator, RefCount>::compare(
+    const CharT* s) const noexcept {
+  return _compare(s, Traits::length(s));
+}
+template <class CharT, class Traits, class Allocator, class RefCount>
+int basic_rope<CharT, Traits, Allocator, RefCount>::_compare(
+    const CharT* s, size_type count) const noexcept {
+  size_type pos = 0;
+  int res = 0;
+  auto compare_chunk = [&](const CharT* data, size_type n) {
+    n = std::min(n, count - pos);
+    res = Traits::compare(data, s + pos, n);
+    pos += n;
+    return res == 0 && pos < count;
+  };
+  if (m_root && count != 0) _for_each_chunk(m_root.get(), compare_chunk);
+  if (res != 0) return res;
+  return size() < count ? -1 : size() > count ? 1 : 0;
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+template <class F>
+void basic_rope<CharT, Traits, Allocator, RefCount>::for_each_chunk(F f) const {
+  auto visit = [&f](const CharT* data, size_type count) {
+    f(data, count);
+    return true;
+  };
+  if (m_root) _for_each_chunk(m_root.get(), visit);
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_rope<CharT, Traits, Allocator, RefCount>::string_type
+basic_rope<CharT, Traits, Allocator, RefCount>::str() const {
+  if (!m_root) return string_type(m_alloc);
+  if (m_root->height == 0) return m_root->leaf;
+
+  basic_string_builder<CharT, Traits, Allocator, RefCount> builder(size(),
+                                                                   m_alloc);
+  for_each_chunk(
+      [&builder](const CharT* data, size_type count) {
+        builder.append(data, count);
+      });
+  return builder.build();
+}
+
+// tree
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_rope<CharT, Traits, Allocator, RefCount>::node_ptr
+basic_rope<CharT, Traits, Allocator, RefCount>::_leaf(
+    string_type chars) const {
+  return std::allocate_shared<node>(m_alloc, std::move(chars));
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_rope<CharT, Traits, Allocator, RefCount>::node_ptr
+basic_rope<CharT, Traits, Allocator, RefCount>::_inner(node_ptr left,
+                                                       node_ptr right) const {
+  return std::allocate_shared<node>(m_alloc, std::move(left),
+                                    std::move(right));
+}
+
+// Joins trees whose heights differ by at most two, rotating once or twice.
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_rope<CharT, Traits, Allocator, RefCount>::node_ptr
+basic_rope<CharT, Traits, Allocator, RefCount>::_balance(
+    const node_ptr& left, const node_ptr& right) const {
+  if (left->height > right->height + 1) {
+    if (left->left->height >= left->right->height) {
+      return _inner(left->left, _inner(left->right, right));
+    }
+    return _inner(_inner(left->left, left->right->left),
+                  _inner(left->right->right, right));
+  }
+  if (right->height > left->height + 1) {
+    if (right->right->height >= right->left->height) {
+      return _inner(_inner(left, right->left), right->right);
+    }
+    return _inner(_inner(left, right->left->left),
+                  _inner(right->left->right, right->right));
+  }
+  return _inner(left, right);
+}
+
+// Descends the taller tree along the side facing the other one until the
+// heights match, or until the leaves meet when one side is a small chunk, so
+// that it may be merged with its neighbour. The result is at most one level
+// taller than the taller tree.
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_rope<CharT, Traits, Allocator, RefCount>::node_ptr
+basic_rope<CharT, Traits, Allocator, RefCount>::_join(
+    const node_ptr& left, const node_ptr& right) const {
+  if (!left) return right;
+  if (!right) return left;
+
+  if (left->height == 0 && right->height == 0 &&
+      left->size + right->size <= merge_size) {
+    basic_string_builder<CharT, Traits, Allocator, RefCount> builder(
+        left->size + right->size, m_alloc);
+    builder.append(left->leaf).append(right->leaf);
+    return _leaf(builder.build());
+  }
+  const auto small_right = right->height == 0 && right->size < merge_size;
+  const auto small_left = left->height == 0 && left->size < merge_size;
+  if (left->height > right->height + 1 ||
+      (small_right && left->height > 0)) {
+    return _balance(left->left, _join(left->right, right));
+  }
+  if (right->height > left->height + 1 || (small_left && right->height > 0)) {
+    return _balance(_join(left, right->left), right->right);
+  }
+  return _inner(left, right);
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_rope<CharT, Traits, Allocator, RefCount>::node_ptr
+basic_rope<CharT, Traits, Allocator, RefCount>::_slice(const node_ptr& n,
+                                                       size_type begin,
+                                                       size_type end) const {
+  if (begin == 0 && end == n->size) return n;
+  if (n->height == 0) return _leaf(n->leaf.substr(begin, end - begin));
+
+  const auto left_size = n->left->size;
+  if (end <= left_size) return _slice(n->left, begin, end);
+  if (begin >= left_size) {
+    return _slice(n->right, begin - left_size, end - left_size);
+  }
+  return _join(_slice(n->left, begin, left_size),
+               _slice(n->right, 0, end - left_size));
+}
+
+// Stops as soon as f returns false, and returns false then.
+template <class CharT, class Traits, class Allocator, class RefCount>
+template <class F>
+bool basic_rope<CharT, Traits, Allocator, RefCount>::_for_each_chunk(
+    const node* n, F& f) {
+  if (n->height == 0) return f(n->leaf.data(), n->leaf.size());
+  return _for_each_chunk(n->left.get(), f) &&
+         _for_each_chunk(n->right.get(), f);
+}
+
+template <class CharT, class Traits, class Alloc, class RefCount>
+basic_rope<CharT, Traits, Alloc, RefCount> operator+(
+    const basic_rope<CharT, Traits, Alloc, RefCount>& lhs,
+    const basic_rope<CharT, Traits, Alloc, RefCount>& rhs) {
+  return lhs.append(rhs);
+}
+
+template <class CharT, class Traits, class Alloc, class RefCount>
+bool operator==(const basic_rope<CharT, Traits, Alloc, RefCount>& lhs,
+                const basic_rope<CharT, Traits, Alloc, RefCount>& rhs) {
+  return lhs.size() == rhs.size() && lhs.compare(rhs) == 0;
+}
+template <class CharT, class Traits, class Alloc, class RefCount>
+bool operator!=(const basic_rope<CharT, Traits, Alloc, RefCount>& lhs,
+                const basic_rope<CharT, Traits, Alloc, RefCount>& rhs) {
+  return !(lhs == rhs);
+}
+template <class CharT, class Traits, class Alloc, class RefCount>
+bool operator<(const basic_rope<CharT, Traits, Alloc, RefCount>& lhs,
+               const basic_rope<CharT, Traits, Alloc, RefCount>& rhs) {
+  return lhs.compare(rhs) < 0;
+}
+template <class CharT, class Traits, class Alloc, class RefCount>
+bool operator<=(const basic_rope<CharT, Traits, Alloc, RefCount>& lhs,
+                const basic_rope<CharT, Traits, Alloc, RefCount>& rhs) {
+  return lhs.compare(rhs) <= 0;
+}
+template <class CharT, class Traits, class Alloc, class RefCount>
+bool operator>(const basic_rope<CharT, Traits, Alloc, RefCount>& lhs,
+               const basic_rope<CharT, Traits, Alloc, RefCount>& rhs) {
+  return rhs < lhs;
+}
+template <class CharT, class Traits, class Alloc, class RefCount>
+bool operator>=(const basic_rope<CharT, Traits, Alloc, RefCount>& lhs,
+                const basic_rope<CharT, Traits, Alloc, RefCount>& rhs) {
+  return rhs <= lhs;
+}
+
+template <class CharT, class Traits, class Alloc, class RefCount>
+bool operator==(const basic_rope<CharT, Traits, Alloc, RefCount>& lhs,
+                const basic_string<CharT, Traits, Alloc, RefCount>& rhs) {
+  return lhs.size() == rhs.size() && lhs.compare(rhs) == 0;
+}
+template <class CharT, class Traits, class Alloc, class RefCount>
+bool operator==(const basic_string<CharT, Traits, Alloc, RefCount>& lhs,
+                const basic_rope<CharT, Traits, Alloc, RefCount>& rhs) {
+  return rhs == lhs;
+}
+template <class CharT, class Traits, class Alloc, class RefCount>
+bool operator!=(const basic_rope<CharT, Traits, Alloc, RefCount>& lhs,
+                const basic_string<CharT, Traits, Alloc, RefCount>& rhs) {
+  return !(lhs == rhs);
+}
+template <class CharT, class Traits, class Alloc, class RefCount>
+bool operator!=(const basic_string<CharT, Traits, Alloc, RefCount>& lhs,
+                const basic_rope<CharT, Traits, Alloc, RefCount>& rhs) {
+  return !(rhs == lhs);
+}
+
+template <class CharT, class Traits, class Alloc, class RefCount>
+bool operator==(const basic_rope<CharT, Traits, Alloc, RefCount>& lhs,
+                const CharT* rhs) {
+  return lhs.compare(rhs) == 0;
+}
+template <class CharT, class Traits, class Alloc, class RefCount>
+bool operator==(const CharT* lhs,
+                const basic_rope<CharT, Traits, Alloc, RefCount>& rhs) {
+  return rhs.compare(lhs) == 0;
+}
+template <class CharT, class Traits, class Alloc, class RefCount>
+bool operator!=(const basic_rope<CharT, Traits, Alloc, RefCount>& lhs,
+                const CharT* rhs) {
+  return !(lhs == rhs);
+}
+template <class CharT, class Traits, class Alloc, class RefCount>
+bool operator!=(const CharT* lhs,
+                const basic_rope<CharT, Traits, Alloc, RefCount>& rhs) {
+  return !(rhs == lhs);
+}
+
+}  // namespace immutable_string
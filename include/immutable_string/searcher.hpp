@@ -0,0 +1,105 @@
+#pragma once
+
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "string.hpp"
+
+namespace immutable_string {
+
+// A needle prepared once for searching many strings:
+//   const searcher needle{string{"needle"}};
+//   text.find(needle);
+//   std::search(text.begin(), text.end(), needle);  // C++17
+// The Two-Way factorization of the needle is made once: needles of
+// byte-sized characters fall back on it where the vectorized search gives
+// up, other long ones are searched with it.
+template <class CharT, class Traits = std::char_traits<CharT>,
+          class Allocator = std::allocator<CharT>,
+          class RefCount = atomic_refcount>
+class basic_searcher {
+ public:
+  using string_type = basic_string<CharT, Traits, Allocator, RefCount>;
+  using size_type = typename string_type::size_type;
+
+  explicit basic_searcher(string_type needle) noexcept;
+
+  const string_type& needle() const noexcept { return m_needle; }
+
+  // Returns the position of the needle in [s, s + n) or string_type::npos.
+  size_type find(const CharT* s, size_type n) const;
+
+  // Searcher interface of std::search for contiguous iterators.
+  template <class ContiguousIt>
+  std::pair<ContiguousIt, ContiguousIt> operator()(ContiguousIt first,
+                                                   ContiguousIt last) const;
+
+ private:
+  using searchable = typename string_type::searchable;
+  // the vectorized search compares bytes
+  using two_way_char =
+      typename std::conditional<searchable::value, char, CharT>::type;
+  using two_way_traits =
+      typename std::conditional<searchable::value, std::char_traits<char>,
+                                Traits>::type;
+
+  size_type _find(const CharT* s, size_type n, std::true_type) const noexcept;
+  size_type _find(const CharT* s, size_type n, std::false_type) const;
+
+  string_type m_needle;
+  detail::two_way<two_way_char, two_way_traits> m_two_way;
+};
+
+using searcher = basic_searcher<char>;
+using wsearcher = basic_searcher<wchar_t>;
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+basic_searcher<CharT, Traits, Allocator, RefCount>::basic_searcher(
+    string_type needle) noexcept
+    : m_needle(std::move(needle)),
+      m_two_way(reinterpret_cast<const two_way_char*>(m_needle.data()),
+                m_needle.size()) {}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_searcher<CharT, Traits, Allocator, RefCount>::size_type
+basic_searcher<CharT, Traits, Allocator, RefCount>::find(
+    const CharT* s, size_type n) const {
+  return _find(s, n, searchable{});
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_searcher<CharT, Traits, Allocator, RefCount>::size_type
+basic_searcher<CharT, Traits, Allocator, RefCount>::_find(
+    const CharT* s, size_type n, std::true_type) const noexcept {
+  const auto count = m_needle.size();
+  if (count < 2 || count > n) {
+    return string_type::_find(s, n, m_needle.data(), count);
+  }
+  return detail::find(reinterpret_cast<const char*>(s), n,
+                      reinterpret_cast<const char*>(m_needle.data()), count,
+                      m_two_way);
+}
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_searcher<CharT, Traits, Allocator, RefCount>::size_type
+basic_searcher<CharT, Traits, Allocator, RefCount>::_find(
+    const CharT* s, size_type n, std::false_type) const {
+  if (m_needle.size() < detail::two_way_threshold) {
+    return string_type::_find(s, n, m_needle.data(), m_needle.size());
+  }
+  const auto found = m_two_way.find(m_needle.data(), s, n);
+  return found == detail::not_found ? string_type::npos : found;
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+template <class ContiguousIt>
+std::pair<ContiguousIt, ContiguousIt>
+basic_searcher<CharT, Traits, Allocator, RefCount>::operator()(
+    ContiguousIt first, ContiguousIt last) const {
+  const CharT* s = first == last ? nullptr : &*first;
+  const auto found = find(s, static_cast<size_type>(last - first));
+  if (found == string_type::npos) return {last, last};
+  return {first + found, first + found + m_needle.size()};
+}
+
+}  // namespace immutable_string
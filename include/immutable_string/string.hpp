@@ -1,47 +1,159 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <new>
+#include <stdexcept>
 #include <string>
+#include <type_traits>
 
-#include <boost/smart_ptr/allocate_shared_array.hpp>
-#include <boost/smart_ptr/shared_ptr.hpp>
+#include "detail/find.hpp"
+#include "detail/hash.hpp"
+#include "refcount.hpp"
 
 namespace immutable_string {
 
+namespace detail {
+
+#if defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__) && \
+    __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+constexpr bool is_little_endian = false;
+#else
+constexpr bool is_little_endian = true;
+#endif
+
+// Moves the lowest byte of a word to the first byte in memory, so that an
+// even word can share its first byte with the tag of an inline string.
+template <class T>
+constexpr T to_tag_order(T value) noexcept {
+  return is_little_endian ? value
+                          : (value >> 8) | (value << (sizeof(T) * 8 - 8));
+}
+template <class T>
+constexpr T from_tag_order(T value) noexcept {
+  return is_little_endian ? value
+                          : (value << 8) | (value >> (sizeof(T) * 8 - 8));
+}
+
+// Keeps an empty allocator from taking space in a string header.
+template <class Alloc, bool = std::is_empty<Alloc>::value>
+struct allocator_holder : private Alloc {
+  explicit allocator_holder(const Alloc& alloc) : Alloc(alloc) {}
+  const Alloc& allocator() const noexcept { return *this; }
+};
+template <class Alloc>
+struct allocator_holder<Alloc, false> {
+  explicit allocator_holder(const Alloc& alloc) : m_alloc(alloc) {}
+  const Alloc& allocator() const noexcept { return m_alloc; }
+
+  Alloc m_alloc;
+};
+
+}  // namespace detail
+
+// Selects the constructor of basic_string which references characters owned
+// elsewhere instead of copying them.
+struct adopt_t {
+  // whether the character following the adopted ones is readable and zero
+  bool terminated;
+};
+constexpr adopt_t adopt{false};
+constexpr adopt_t adopt_terminated{true};
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+class basic_searcher;
+template <class CharT, class Traits, class Allocator, class RefCount>
+class basic_matcher;
+template <class CharT, class Traits, class Allocator, class RefCount>
+class basic_intern_pool;
+template <class CharT, class Traits, class Allocator, class RefCount>
+class basic_symbol;
+template <class CharT, class Traits, class Allocator, class RefCount>
+class basic_string_builder;
+
+namespace detail {
+struct concat_access;
+}
+
 template <class CharT, class Traits = std::char_traits<CharT>,
-          class Allocator = std::allocator<CharT>>
+          class Allocator = std::allocator<CharT>,
+          class RefCount = atomic_refcount>
 class basic_string {
  public:
   using traits_type = Traits;
   using value_type = typename traits_type::char_type;
   using allocator_type = Allocator;
-  using size_type = typename allocator_type::size_type;
-  using difference_type = typename allocator_type::difference_type;
-  using reference = typename allocator_type::reference;
-  using const_reference = typename allocator_type::const_reference;
-  using pointer = typename allocator_type::pointer;
-  using const_pointer = typename allocator_type::const_pointer;
-  using iterator = const char*;
-  using const_iterator = const char*;
+  using refcount_type = RefCount;
+  using size_type = typename std::allocator_traits<Allocator>::size_type;
+  using difference_type =
+      typename std::allocator_traits<Allocator>::difference_type;
+  using reference = CharT&;
+  using const_reference = const CharT&;
+  using pointer = typename std::allocator_traits<Allocator>::pointer;
+  using const_pointer =
+      typename std::allocator_traits<Allocator>::const_pointer;
+  using iterator = const CharT*;
+  using const_iterator = const CharT*;
   using reverse_iterator = std::reverse_iterator<iterator>;
   using const_reverse_iterator = std::reverse_iterator<const_iterator>;
 
   static const size_type npos = -1;
+  // whether copies of a string may be used from different threads
+  static constexpr bool is_thread_safe = RefCount::is_thread_safe;
 
-  basic_string();
-  explicit basic_string(const Allocator& alloc);
+  basic_string() noexcept;
+  explicit basic_string(const Allocator& alloc) noexcept;
   basic_string(size_type count, CharT ch, const Allocator& alloc = Allocator());
   basic_string(const CharT* s, const Allocator& alloc = Allocator());
   basic_string(const CharT* s, size_type count,
                const Allocator& alloc = Allocator());
+  // Adopts `count` characters at `s` owned elsewhere, e.g. by a refcounted
+  // I/O buffer, without copying them: deleter(s) is called and the deleter
+  // destroyed once no string references them. With adopt_terminated s[count]
+  // shall be zero, so that c_str() needs no copy either. Strings fitting
+  // inline are copied and the deleter is called right away, as it is when
+  // the constructor throws. Not available to policies freeing no string, as
+  // that of arena strings, which would never call the deleter.
+  template <class Deleter>
+  basic_string(adopt_t how, const CharT* s, size_type count, Deleter deleter,
+               const Allocator& alloc = Allocator());
+  // String of the characters Chars referencing static storage, so that it is
+  // made, copied and destroyed without allocating or counting references.
+  // Usually written as a literal: "content-type"_is.
+  template <CharT... Chars>
+  static basic_string from_literal() noexcept;
+
+  basic_string(const basic_string& other) noexcept;
+  basic_string(basic_string&& other) noexcept;
+  ~basic_string();
+
+  basic_string& operator=(const basic_string& other) noexcept;
+  basic_string& operator=(basic_string&& other) noexcept;
 
   const_reference operator[](size_type pos) const noexcept;
   const_reference at(size_type pos) const;
   const_reference front() const noexcept { return (*this)[0]; }
   const_reference back() const noexcept { return (*this)[size() - 1]; }
-  const CharT* data() const noexcept { return m_data.get(); }
-  const CharT* c_str() const noexcept { return data(); }
+  const CharT* data() const noexcept;
+  // an unterminated substring makes a terminated copy of itself once
+  const CharT* c_str() const;
 
-  bool empty() const noexcept { return m_size == 0; }
-  size_type size() const noexcept { return m_size; }
+  bool empty() const noexcept { return size() == 0; }
+  size_type size() const noexcept;
   size_type length() const noexcept { return size(); }
+  // number of strings sharing the characters, 1 for inline strings and 0 for
+  // literals
+  std::size_t use_count() const noexcept;
+  // Hash of the characters, computed once and shared by all copies.
+  std::size_t hash() const noexcept;
+  // Allocator of the characters. Inline strings and literals have none and
+  // return a default constructed one, or throw std::invalid_argument if it
+  // cannot be default constructed.
+  allocator_type get_allocator() const;
 
   iterator begin() const noexcept;
   iterator end() const noexcept;
@@ -57,6 +169,16 @@ class basic_string {
   size_type find(const CharT* s, size_type pos, size_type count) const;
   size_type find(const CharT* s, size_type pos = 0) const;
   size_type find(CharT ch, size_type pos = 0) const;
+  size_type find(
+      const basic_searcher<CharT, Traits, Allocator, RefCount>& searcher,
+      size_type pos = 0) const;
+
+  // Substrings longer than the inline capacity share the characters of this
+  // string instead of copying them.
+  basic_string substr(size_type pos = 0, size_type count = npos) const;
+  // Copies a substring into its own buffer, so that it stops keeping alive
+  // the string it was taken from.
+  basic_string compact() const;
 
   int compare(const basic_string& str) const noexcept;
   int compare(const CharT* s) const noexcept;
@@ -66,251 +188,891 @@ class basic_string {
 
  private:
   void _throw_out_of_range() const { throw std::out_of_range("basic_string"); }
+  void _throw_length_error() const { throw std::length_error("basic_string"); }
+
+  using counter = typename RefCount::counter;
+
+  // Heap strings point to a header, so the string itself is one pointer wide.
+  // The counter comes first, which lets _destroy get from it back to the
+  // header, and `free` releases whatever the particular header owns.
+  struct heap_header {
+    constexpr heap_header(size_type count, const CharT* chars,
+                          void (*free_header)(heap_header*),
+                          void (*destroy)(counter*) = &_destroy) noexcept
+        : refs(destroy),
+          size(count),
+          data(chars),
+          free(free_header),
+          hash(0) {}
+
+    counter refs;
+    size_type size;
+    const CharT* data;
+    void (*free)(heap_header*);
+    // computed by hash() on first use, 0 until then
+    std::atomic<std::size_t> hash;
+  };
+  // Characters owned by a string directly follow its header, in a single
+  // allocation.
+  struct buffer_header : heap_header, detail::allocator_holder<Allocator> {
+    buffer_header(const Allocator& alloc, size_type count) noexcept
+        : heap_header(count, reinterpret_cast<CharT*>(this + 1), &_free_buffer),
+          detail::allocator_holder<Allocator>(alloc) {}
+  };
+  // Characters not owned by the header, which may need a terminated copy.
+  struct view_header : heap_header, detail::allocator_holder<Allocator> {
+    view_header(const Allocator& alloc, const CharT* chars, size_type count,
+                void (*free_header)(heap_header*), bool is_terminated) noexcept
+        : heap_header(count, chars, free_header),
+          detail::allocator_holder<Allocator>(alloc),
+          terminated(is_terminated),
+          cstr(nullptr) {}
+
+    // whether the character following them is readable and zero
+    bool terminated;
+    // terminated copy made by c_str()
+    std::atomic<CharT*> cstr;
+  };
+  // A substring referencing the characters of another heap string.
+  struct slice_header : view_header {
+    slice_header(const Allocator& alloc, heap_header* parent_header,
+                 const CharT* chars, size_type count,
+                 bool is_terminated) noexcept
+        : view_header(alloc, chars, count, &_free_slice, is_terminated),
+          parent(parent_header) {
+      if (parent) parent->refs.acquire();
+    }
+
+    // null for literals, which are not counted
+    heap_header* parent;
+  };
+  // Adopted characters, released by the deleter.
+  template <class Deleter>
+  struct external_header : view_header {
+    external_header(const Allocator& alloc, const CharT* chars,
+                    size_type count, bool is_terminated,
+                    Deleter&& chars_deleter) noexcept
+        : view_header(alloc, chars, count, &_free_external<Deleter>,
+                      is_terminated),
+          deleter(std::move(chars_deleter)) {}
+
+    Deleter deleter;
+  };
+  // Literals are never freed, so their headers live in static storage and
+  // their strings do not count references. The headers are constant-
+  // initialized, with counters made for no `destroy`, so that literals may be
+  // used by initializers of other statics.
+  template <CharT... Chars>
+  struct literal {
+    static constexpr CharT chars[sizeof...(Chars) + 1] = {Chars..., CharT()};
+    static heap_header header;
+  };
+  using buffer_allocator = typename std::allocator_traits<
+      Allocator>::template rebind_alloc<buffer_header>;
+  using slice_allocator = typename std::allocator_traits<
+      Allocator>::template rebind_alloc<slice_header>;
+
+  static const size_type local_slots =
+      sizeof(std::uintptr_t) / sizeof(CharT) > 2
+          ? sizeof(std::uintptr_t) / sizeof(CharT)
+          : 2;
+
+  // Strings up to local_capacity characters are stored inline: the first byte
+  // holds (size << 1) | 1 and the characters start at m_local[1]. Heap strings
+  // store the header address there, which is even, so the lowest bit tells the
+  // two apart. Literals set the second bit of the address, which is zero too.
+  static const size_type local_capacity = local_slots - 2;
+  static const std::uintptr_t literal_tag = 2;
+  static_assert(local_capacity < 128, "inline size shall fit into the tag");
+  static_assert(alignof(heap_header) > literal_tag,
+                "header address shall leave room for the tags");
+  static_assert(std::is_standard_layout<heap_header>::value,
+                "counter shall be pointer-interconvertible with the header");
+
+  bool _is_local() const noexcept {
+    return *reinterpret_cast<const unsigned char*>(m_local) & 1;
+  }
+  // false for inline strings and literals
+  bool _is_counted() const noexcept {
+    return (*reinterpret_cast<const unsigned char*>(m_local) & 3) == 0;
+  }
+  heap_header* _header() const noexcept {
+    return reinterpret_cast<heap_header*>(detail::from_tag_order(m_word) &
+                                          ~literal_tag);
+  }
+  void _set_header(heap_header* header, std::uintptr_t tag = 0) noexcept {
+    m_word = detail::to_tag_order(reinterpret_cast<std::uintptr_t>(header) |
+                                  tag);
+  }
+  static bool _is_buffer(const heap_header* header) noexcept {
+    return header->free == &_free_buffer;
+  }
+  static bool _is_slice(const heap_header* header) noexcept {
+    return header->free == &_free_slice;
+  }
+  static bool _is_terminated(const heap_header* header) noexcept {
+    return _is_buffer(header) || header->free == &_free_literal ||
+           static_cast<const view_header*>(header)->terminated;
+  }
+  static const Allocator& _allocator(const heap_header* header) noexcept {
+    if (_is_buffer(header)) {
+      return static_cast<const buffer_header*>(header)->allocator();
+    }
+    return static_cast<const view_header*>(header)->allocator();
+  }
+  static size_type _buffer_blocks(size_type count) noexcept {
+    return 1 + ((count + 1) * sizeof(CharT) + sizeof(buffer_header) - 1) /
+                   sizeof(buffer_header);
+  }
+  CharT* _init(size_type count, const Allocator& alloc);
+  CharT* _init_local(size_type count) noexcept;
+  void _release() noexcept;
+  static std::size_t _hash(const CharT* s, size_type count) noexcept {
+    return static_cast<std::size_t>(
+        detail::wyhash::hash(s, count * sizeof(CharT)));
+  }
+  const CharT* _terminated_copy() const;
+  template <class, class, class, class>
+  friend class basic_searcher;
+  template <class, class, class, class>
+  friend class basic_matcher;
+  template <class, class, class, class>
+  friend class basic_intern_pool;
+  template <class, class, class, class>
+  friend class basic_symbol;
+  template <class, class, class, class>
+  friend class basic_string_builder;
+  friend struct detail::concat_access;
+  template <class C, class T, class A, class R>
+  friend bool operator==(const basic_string<C, T, A, R>& lhs,
+                         const basic_string<C, T, A, R>& rhs);
+  bool _equals(const basic_string& str) const noexcept;
+  using searchable = detail::is_byte_searchable<CharT, Traits>;
+  static size_type _find(const CharT* s, size_type n, const CharT* needle,
+                         size_type count);
+  static size_type _find(const CharT* s, size_type n, CharT ch,
+                         std::true_type) noexcept;
+  static size_type _find(const CharT* s, size_type n, CharT ch,
+                         std::false_type);
+  static size_type _find(const CharT* s, size_type n, const CharT* needle,
+                         size_type count, std::true_type) noexcept;
+  static size_type _find(const CharT* s, size_type n, const CharT* needle,
+                         size_type count, std::false_type);
+  static void _destroy(counter* refs) noexcept;
+  static void _free_buffer(heap_header* header) noexcept;
+  static void _free_slice(heap_header* header) noexcept;
+  template <class Deleter>
+  static void _free_external(heap_header* header) noexcept;
+  static void _free_cstr(view_header* view) noexcept;
+  static void _free_literal(heap_header*) noexcept {}
+  // allocator for substrings of literals
+  static Allocator _literal_allocator(std::true_type) { return Allocator(); }
+  [[noreturn]] static Allocator _literal_allocator(std::false_type) {
+    std::terminate();
+  }
+  static Allocator _default_allocator(std::true_type) { return Allocator(); }
+  [[noreturn]] static Allocator _default_allocator(std::false_type) {
+    throw std::invalid_argument("basic_string has no allocator");
+  }
 
  private:
-  boost::shared_ptr<CharT[]> m_data;
-  size_type m_size;
+  union {
+    std::uintptr_t m_word;
+    CharT m_local[local_slots];
+  };
 };
 
 using string = basic_string<char>;
 using wstring = basic_string<wchar_t>;
 
-template <class CharT, class Traits, class Allocator>
-const typename basic_string<CharT, Traits, Allocator>::size_type
-    basic_string<CharT, Traits, Allocator>::npos;
+template <class CharT, class Traits, class Allocator, class RefCount>
+const typename basic_string<CharT, Traits, Allocator, RefCount>::size_type
+    basic_string<CharT, Traits, Allocator, RefCount>::npos;
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+constexpr bool basic_string<CharT, Traits, Allocator, RefCount>::is_thread_safe;
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+const typename basic_string<CharT, Traits, Allocator, RefCount>::size_type
+    basic_string<CharT, Traits, Allocator, RefCount>::local_slots;
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+const typename basic_string<CharT, Traits, Allocator, RefCount>::size_type
+    basic_string<CharT, Traits, Allocator, RefCount>::local_capacity;
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+const std::uintptr_t
+    basic_string<CharT, Traits, Allocator, RefCount>::literal_tag;
 
-template <class CharT, class Traits, class Allocator>
-basic_string<CharT, Traits, Allocator>::basic_string() : basic_string("") {}
+template <class CharT, class Traits, class Allocator, class RefCount>
+template <CharT... Chars>
+constexpr CharT basic_string<CharT, Traits, Allocator,
+                             RefCount>::literal<Chars...>::chars[];
 
-template <class CharT, class Traits, class Allocator>
-basic_string<CharT, Traits, Allocator>::basic_string(size_type count, CharT ch,
-                                                     const Allocator& alloc)
-    : m_data(boost::allocate_shared<CharT[]>(alloc, count + 1)), m_size(count) {
-  Traits::assign(m_data.get(), count, ch);
+template <class CharT, class Traits, class Allocator, class RefCount>
+template <CharT... Chars>
+typename basic_string<CharT, Traits, Allocator, RefCount>::heap_header
+    basic_string<CharT, Traits, Allocator, RefCount>::literal<Chars...>::header{
+        sizeof...(Chars), chars, &_free_literal, nullptr};
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+basic_string<CharT, Traits, Allocator, RefCount>::basic_string() noexcept {
+  _init_local(0);
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+basic_string<CharT, Traits, Allocator, RefCount>::basic_string(
+    size_type count, CharT ch, const Allocator& alloc) {
+  Traits::assign(_init(count, alloc), count, ch);
 }
 
-template <class CharT, class Traits, class Allocator>
-basic_string<CharT, Traits, Allocator>::basic_string(const Allocator& alloc)
-    : basic_string("", alloc) {}
+template <class CharT, class Traits, class Allocator, class RefCount>
+basic_string<CharT, Traits, Allocator, RefCount>::basic_string(
+    const Allocator&) noexcept
+    : basic_string() {}
 
-template <class CharT, class Traits, class Allocator>
-basic_string<CharT, Traits, Allocator>::basic_string(const CharT* s,
-                                                     const Allocator& alloc)
+template <class CharT, class Traits, class Allocator, class RefCount>
+basic_string<CharT, Traits, Allocator, RefCount>::basic_string(
+    const CharT* s, const Allocator& alloc)
     : basic_string(s, Traits::length(s), alloc) {}
 
-template <class CharT, class Traits, class Allocator>
-basic_string<CharT, Traits, Allocator>::basic_string(const CharT* s,
-                                                     size_type count,
-                                                     const Allocator& alloc)
-    : m_data(boost::allocate_shared<CharT[]>(alloc, count + 1)), m_size(count) {
-  // allocate_shared returns value initialized array
+template <class CharT, class Traits, class Allocator, class RefCount>
+basic_string<CharT, Traits, Allocator, RefCount>::basic_string(
+    const CharT* s, size_type count, const Allocator& alloc) {
+  // _init returns value initialized buffer
   // so, we don't need to fill last element with zero
-  Traits::copy(m_data.get(), s, count);
+  Traits::copy(_init(count, alloc), s, count);
 }
 
-template <class CharT, class Traits, class Allocator>
-typename basic_string<CharT, Traits, Allocator>::const_reference
-    basic_string<CharT, Traits, Allocator>::operator[](size_type pos) const
-    noexcept {
+template <class CharT, class Traits, class Allocator, class RefCount>
+template <class Deleter>
+basic_string<CharT, Traits, Allocator, RefCount>::basic_string(
+    adopt_t how, const CharT* s, size_type count, Deleter deleter,
+    const Allocator& alloc) {
+  static_assert(RefCount::frees_strings,
+                "an adopted buffer is released when its string is freed");
+  static_assert(std::is_nothrow_move_constructible<Deleter>::value,
+                "the deleter is moved into the header after allocating it");
+  if (count <= local_capacity) {
+    Traits::copy(_init_local(count), s, count);
+    deleter(s);
+    return;
+  }
+
+  using header_allocator = typename std::allocator_traits<
+      Allocator>::template rebind_alloc<external_header<Deleter>>;
+  header_allocator headers(alloc);
+  external_header<Deleter>* header;
+  try {
+    header = std::allocator_traits<header_allocator>::allocate(headers, 1);
+  } catch (...) {
+    deleter(s);
+    throw;
+  }
+  new (header) external_header<Deleter>(alloc, s, count, how.terminated,
+                                        std::move(deleter));
+  _set_header(header);
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+template <CharT... Chars>
+basic_string<CharT, Traits, Allocator, RefCount>
+basic_string<CharT, Traits, Allocator, RefCount>::from_literal() noexcept {
+  static_assert(std::is_default_constructible<Allocator>::value,
+                "substrings of literals use a default constructed allocator");
+  static_assert((counter(nullptr), true),
+                "literal counters shall be made in constant expressions");
+  basic_string result;
+  const auto count = sizeof...(Chars);
+  if (count <= local_capacity) {
+    Traits::copy(result._init_local(count), literal<Chars...>::chars, count);
+  } else {
+    result._set_header(&literal<Chars...>::header, literal_tag);
+  }
+  return result;
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+basic_string<CharT, Traits, Allocator, RefCount>::basic_string(
+    const basic_string& other) noexcept {
+  if (other._is_counted()) {
+    m_word = other.m_word;
+    _header()->refs.acquire();
+  } else {
+    Traits::copy(m_local, other.m_local, local_slots);
+  }
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+basic_string<CharT, Traits, Allocator, RefCount>::basic_string(
+    basic_string&& other) noexcept {
+  if (other._is_local()) {
+    Traits::copy(m_local, other.m_local, local_slots);
+  } else {
+    m_word = other.m_word;
+    other._init_local(0);
+  }
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+basic_string<CharT, Traits, Allocator, RefCount>::~basic_string() {
+  _release();
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+basic_string<CharT, Traits, Allocator, RefCount>&
+basic_string<CharT, Traits, Allocator, RefCount>::operator=(
+    const basic_string& other) noexcept {
+  if (this != &other) {
+    _release();
+    new (this) basic_string(other);
+  }
+  return *this;
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+basic_string<CharT, Traits, Allocator, RefCount>&
+basic_string<CharT, Traits, Allocator, RefCount>::operator=(
+    basic_string&& other) noexcept {
+  if (this != &other) {
+    _release();
+    new (this) basic_string(std::move(other));
+  }
+  return *this;
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+CharT* basic_string<CharT, Traits, Allocator, RefCount>::_init(
+    size_type count, const Allocator& alloc) {
+  if (count <= local_capacity) return _init_local(count);
+  if (count > (size_type(-1) - sizeof(buffer_header)) / sizeof(CharT) - 1) {
+    _throw_length_error();
+  }
+
+  buffer_allocator blocks(alloc);
+  auto header = std::allocator_traits<buffer_allocator>::allocate(
+      blocks, _buffer_blocks(count));
+  new (header) buffer_header(alloc, count);
+  _set_header(header);
+
+  auto chars = reinterpret_cast<CharT*>(header + 1);
+  Traits::assign(chars[count], CharT());
+  return chars;
+}
+
+// an empty string is just a zeroed inline buffer, so default-constructed and
+// moved-from strings never touch the allocator or a reference counter
+template <class CharT, class Traits, class Allocator, class RefCount>
+CharT* basic_string<CharT, Traits, Allocator, RefCount>::_init_local(
+    size_type count) noexcept {
+  Traits::assign(m_local, local_slots, CharT());
+  *reinterpret_cast<unsigned char*>(m_local) =
+      static_cast<unsigned char>(count << 1 | 1);
+  return m_local + 1;
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+void basic_string<CharT, Traits, Allocator, RefCount>::_release() noexcept {
+  if (!_is_counted()) return;
+  if (_header()->refs.release()) _destroy(&_header()->refs);
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+void basic_string<CharT, Traits, Allocator, RefCount>::_destroy(
+    counter* refs) noexcept {
+  const auto header = reinterpret_cast<heap_header*>(refs);
+  header->free(header);
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+void basic_string<CharT, Traits, Allocator, RefCount>::_free_buffer(
+    heap_header* header) noexcept {
+  const auto buffer = static_cast<buffer_header*>(header);
+  buffer_allocator blocks(buffer->allocator());
+  const auto count = _buffer_blocks(buffer->size);
+  buffer->~buffer_header();
+  std::allocator_traits<buffer_allocator>::deallocate(blocks, buffer, count);
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+void basic_string<CharT, Traits, Allocator, RefCount>::_free_slice(
+    heap_header* header) noexcept {
+  const auto slice = static_cast<slice_header*>(header);
+  const auto parent = slice->parent;
+  if (parent && parent->refs.release()) _destroy(&parent->refs);
+
+  _free_cstr(slice);
+  slice_allocator slices(slice->allocator());
+  slice->~slice_header();
+  std::allocator_traits<slice_allocator>::deallocate(slices, slice, 1);
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+template <class Deleter>
+void basic_string<CharT, Traits, Allocator, RefCount>::_free_external(
+    heap_header* header) noexcept {
+  const auto external = static_cast<external_header<Deleter>*>(header);
+  external->deleter(external->data);
+
+  _free_cstr(external);
+  using header_allocator = typename std::allocator_traits<
+      Allocator>::template rebind_alloc<external_header<Deleter>>;
+  header_allocator headers(external->allocator());
+  external->~external_header();
+  std::allocator_traits<header_allocator>::deallocate(headers, external, 1);
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+void basic_string<CharT, Traits, Allocator, RefCount>::_free_cstr(
+    view_header* view) noexcept {
+  if (const auto cstr = view->cstr.load(std::memory_order_acquire)) {
+    Allocator alloc(view->allocator());
+    std::allocator_traits<Allocator>::deallocate(alloc, cstr, view->size + 1);
+  }
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+const CharT* basic_string<CharT, Traits, Allocator, RefCount>::data()
+    const noexcept {
+  return _is_local() ? m_local + 1 : _header()->data;
+}
+
+// Owned buffers are always terminated, adopted ones when the owner says so.
+// A substring is terminated when the character following it in the parent
+// is zero, or when it is a suffix of a terminated parent.
+template <class CharT, class Traits, class Allocator, class RefCount>
+const CharT* basic_string<CharT, Traits, Allocator, RefCount>::c_str() const {
+  if (_is_local()) return m_local + 1;
+  const auto header = _header();
+  if (_is_terminated(header)) return header->data;
+  return _terminated_copy();
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+const CharT*
+basic_string<CharT, Traits, Allocator, RefCount>::_terminated_copy() const {
+  const auto view = static_cast<view_header*>(_header());
+  auto cstr = view->cstr.load(std::memory_order_acquire);
+  if (cstr) return cstr;
+
+  Allocator alloc(view->allocator());
+  const auto copy =
+      std::allocator_traits<Allocator>::allocate(alloc, view->size + 1);
+  Traits::copy(copy, view->data, view->size);
+  Traits::assign(copy[view->size], CharT());
+  // another thread may have published its copy in the meantime
+  if (!view->cstr.compare_exchange_strong(cstr, copy,
+                                          std::memory_order_acq_rel,
+                                          std::memory_order_acquire)) {
+    std::allocator_traits<Allocator>::deallocate(alloc, copy, view->size + 1);
+    return cstr;
+  }
+  return copy;
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_string<CharT, Traits, Allocator, RefCount>::size_type
+basic_string<CharT, Traits, Allocator, RefCount>::size() const noexcept {
+  if (_is_local()) return *reinterpret_cast<const unsigned char*>(m_local) >> 1;
+  return _header()->size;
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+std::size_t basic_string<CharT, Traits, Allocator, RefCount>::use_count()
+    const noexcept {
+  if (_is_local()) return 1;
+  return _is_counted() ? _header()->refs.use_count() : 0;
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+std::size_t basic_string<CharT, Traits, Allocator, RefCount>::hash()
+    const noexcept {
+  if (_is_local()) return _hash(data(), size());
+
+  const auto header = _header();
+  auto value = header->hash.load(std::memory_order_relaxed);
+  if (value == 0) {
+    value = _hash(header->data, header->size);
+    // threads racing here store the same value
+    header->hash.store(value, std::memory_order_relaxed);
+  }
+  return value;
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+Allocator basic_string<CharT, Traits, Allocator, RefCount>::get_allocator()
+    const {
+  if (_is_counted()) return _allocator(_header());
+  return _default_allocator(std::is_default_constructible<Allocator>());
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_string<CharT, Traits, Allocator, RefCount>::const_reference
+basic_string<CharT, Traits, Allocator, RefCount>::operator[](
+    size_type pos) const noexcept {
   return data()[pos];
 }
 
-template <class CharT, class Traits, class Allocator>
-typename basic_string<CharT, Traits, Allocator>::const_reference
-basic_string<CharT, Traits, Allocator>::at(size_type pos) const {
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_string<CharT, Traits, Allocator, RefCount>::const_reference
+basic_string<CharT, Traits, Allocator, RefCount>::at(size_type pos) const {
   if (pos >= size()) _throw_out_of_range();
   return (*this)[pos];
 }
 
-template <class CharT, class Traits, class Allocator>
-typename basic_string<CharT, Traits, Allocator>::iterator
-basic_string<CharT, Traits, Allocator>::begin() const noexcept {
-  return m_data.get();
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_string<CharT, Traits, Allocator, RefCount>::iterator
+basic_string<CharT, Traits, Allocator, RefCount>::begin() const noexcept {
+  return data();
 }
 
-template <class CharT, class Traits, class Allocator>
-typename basic_string<CharT, Traits, Allocator>::iterator
-basic_string<CharT, Traits, Allocator>::end() const noexcept {
-  return m_data.get() + size();
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_string<CharT, Traits, Allocator, RefCount>::iterator
+basic_string<CharT, Traits, Allocator, RefCount>::end() const noexcept {
+  return data() + size();
 }
 
-template <class CharT, class Traits, class Allocator>
-typename basic_string<CharT, Traits, Allocator>::reverse_iterator
-basic_string<CharT, Traits, Allocator>::rbegin() const noexcept {
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_string<CharT, Traits, Allocator, RefCount>::reverse_iterator
+basic_string<CharT, Traits, Allocator, RefCount>::rbegin() const noexcept {
   return reverse_iterator{end()};
 }
 
-template <class CharT, class Traits, class Allocator>
-typename basic_string<CharT, Traits, Allocator>::reverse_iterator
-basic_string<CharT, Traits, Allocator>::rend() const noexcept {
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_string<CharT, Traits, Allocator, RefCount>::reverse_iterator
+basic_string<CharT, Traits, Allocator, RefCount>::rend() const noexcept {
   return reverse_iterator{begin()};
 }
 
 // find
-template <class CharT, class Traits, class Allocator>
-typename basic_string<CharT, Traits, Allocator>::size_type
-basic_string<CharT, Traits, Allocator>::find(const basic_string& str,
-                                             size_type pos) const {
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_string<CharT, Traits, Allocator, RefCount>::size_type
+basic_string<CharT, Traits, Allocator, RefCount>::find(
+    const basic_string& str, size_type pos) const {
   return find(str.data(), pos, str.size());
 }
-template <class CharT, class Traits, class Allocator>
-typename basic_string<CharT, Traits, Allocator>::size_type
-basic_string<CharT, Traits, Allocator>::find(const CharT* s,
-                                             size_type pos) const {
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_string<CharT, Traits, Allocator, RefCount>::size_type
+basic_string<CharT, Traits, Allocator, RefCount>::find(
+    const CharT* s, size_type pos) const {
   return find(s, pos, Traits::length(s));
 }
-template <class CharT, class Traits, class Allocator>
-typename basic_string<CharT, Traits, Allocator>::size_type
-basic_string<CharT, Traits, Allocator>::find(CharT ch, size_type pos) const {
-  return find(&ch, pos, 1);
-}
-template <class CharT, class Traits, class Allocator>
-typename basic_string<CharT, Traits, Allocator>::size_type
-basic_string<CharT, Traits, Allocator>::find(const CharT* s, size_type pos,
-                                             size_type count) const {
-  const auto is_equal = [s, count](const CharT* s2) {
-    for (size_type i = 0; i < count; ++i) {
-      if (s[i] != s2[i]) return false;
-    }
-    return true;
-  };
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_string<CharT, Traits, Allocator, RefCount>::size_type
+basic_string<CharT, Traits, Allocator, RefCount>::find(
+    CharT ch, size_type pos) const {
+  if (pos >= size()) return npos;
+  const auto found = _find(data() + pos, size() - pos, ch, searchable{});
+  return found == npos ? npos : pos + found;
+}
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_string<CharT, Traits, Allocator, RefCount>::size_type
+basic_string<CharT, Traits, Allocator, RefCount>::find(
+    const CharT* s, size_type pos, size_type count) const {
+  if (pos > size()) return npos;
+  const auto found =
+      count < detail::two_way_threshold || searchable::value
+          ? _find(data() + pos, size() - pos, s, count)
+          : detail::two_way<CharT, Traits>(s, count).find(s, data() + pos,
+                                                          size() - pos);
+  return found == npos ? npos : pos + found;
+}
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_string<CharT, Traits, Allocator, RefCount>::size_type
+basic_string<CharT, Traits, Allocator, RefCount>::find(
+    const basic_searcher<CharT, Traits, Allocator, RefCount>& searcher,
+    size_type pos) const {
+  if (pos > size()) return npos;
+  const auto found = searcher.find(data() + pos, size() - pos);
+  return found == npos ? npos : pos + found;
+}
 
-  while (pos + count <= size()) {
-    if (is_equal(data() + pos)) return pos;
-    ++pos;
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_string<CharT, Traits, Allocator, RefCount>::size_type
+basic_string<CharT, Traits, Allocator, RefCount>::_find(
+    const CharT* s, size_type n, const CharT* needle, size_type count) {
+  if (count > n) return npos;
+  if (count == 0) return 0;
+  if (count == 1) return _find(s, n, *needle, searchable{});
+  return _find(s, n, needle, count, searchable{});
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_string<CharT, Traits, Allocator, RefCount>::size_type
+basic_string<CharT, Traits, Allocator, RefCount>::_find(
+    const CharT* s, size_type n, CharT ch, std::true_type) noexcept {
+  return detail::find_char(reinterpret_cast<const char*>(s), n,
+                           static_cast<char>(ch));
+}
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_string<CharT, Traits, Allocator, RefCount>::size_type
+basic_string<CharT, Traits, Allocator, RefCount>::_find(
+    const CharT* s, size_type n, CharT ch, std::false_type) {
+  const auto found = Traits::find(s, n, ch);
+  return found ? found - s : npos;
+}
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_string<CharT, Traits, Allocator, RefCount>::size_type
+basic_string<CharT, Traits, Allocator, RefCount>::_find(
+    const CharT* s, size_type n, const CharT* needle, size_type count,
+    std::true_type) noexcept {
+  return detail::find(reinterpret_cast<const char*>(s), n,
+                      reinterpret_cast<const char*>(needle), count);
+}
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_string<CharT, Traits, Allocator, RefCount>::size_type
+basic_string<CharT, Traits, Allocator, RefCount>::_find(
+    const CharT* s, size_type n, const CharT* needle, size_type count,
+    std::false_type) {
+  const auto last = s + n - count;
+  for (auto it = s; it <= last; ++it) {
+    it = Traits::find(it, last - it + 1, needle[0]);
+    if (!it) break;
+    if (Traits::compare(it + 1, needle + 1, count - 1) == 0) return it - s;
   }
   return npos;
 }
 
+// substr
+template <class CharT, class Traits, class Allocator, class RefCount>
+basic_string<CharT, Traits, Allocator, RefCount>
+basic_string<CharT, Traits, Allocator, RefCount>::substr(
+    size_type pos, size_type count) const {
+  if (pos > size()) _throw_out_of_range();
+  count = std::min(count, size() - pos);
+  if (count == size()) return *this;
+
+  basic_string result;
+  if (count <= local_capacity) {
+    Traits::copy(result._init_local(count), data() + pos, count);
+    return result;
+  }
+
+  // the characters of an adopted buffer may end without a terminator, so the
+  // one following a suffix is not read
+  auto header = _header();
+  const auto chars = header->data + pos;
+  const Allocator alloc =
+      _is_counted()
+          ? _allocator(header)
+          : _literal_allocator(std::is_default_constructible<Allocator>());
+  const auto terminated = pos + count < header->size
+                              ? Traits::eq(chars[count], CharT())
+                              : _is_terminated(header);
+  // slices of slices reference the original parent directly
+  if (_is_slice(header)) {
+    header = static_cast<slice_header*>(header)->parent;
+  } else if (!_is_counted()) {
+    header = nullptr;
+  }
+
+  slice_allocator slices(alloc);
+  const auto slice =
+      std::allocator_traits<slice_allocator>::allocate(slices, 1);
+  new (slice) slice_header(alloc, header, chars, count, terminated);
+  result._set_header(slice);
+  return result;
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+basic_string<CharT, Traits, Allocator, RefCount>
+basic_string<CharT, Traits, Allocator, RefCount>::compact() const {
+  if (_is_local() || !_is_slice(_header())) return *this;
+
+  basic_string result;
+  Traits::copy(result._init(size(), _allocator(_header())), data(), size());
+  return result;
+}
+
 // compare
-template <class CharT, class Traits, class Allocator>
-int basic_string<CharT, Traits, Allocator>::compare(
-    const basic_string<CharT, Traits, Allocator>& str) const noexcept {
+template <class CharT, class Traits, class Allocator, class RefCount>
+int basic_string<CharT, Traits, Allocator, RefCount>::compare(
+    const basic_string& str) const noexcept {
   return compare(0, size(), str.data(), str.size());
 }
-template <class CharT, class Traits, class Allocator>
-int basic_string<CharT, Traits, Allocator>::compare(const CharT* s) const
-    noexcept {
+template <class CharT, class Traits, class Allocator, class RefCount>
+int basic_string<CharT, Traits, Allocator, RefCount>::compare(
+    const CharT* s) const noexcept {
   return compare(0, size(), s);
 }
-template <class CharT, class Traits, class Allocator>
-int basic_string<CharT, Traits, Allocator>::compare(size_type pos1,
-                                                    size_type count1,
-                                                    const CharT* s) const
-    noexcept {
+template <class CharT, class Traits, class Allocator, class RefCount>
+int basic_string<CharT, Traits, Allocator, RefCount>::compare(
+    size_type pos1, size_type count1, const CharT* s) const noexcept {
   return compare(pos1, count1, s, Traits::length(s));
 }
-template <class CharT, class Traits, class Allocator>
-int basic_string<CharT, Traits, Allocator>::compare(size_type pos1,
-                                                    size_type count1,
-                                                    const CharT* s,
-                                                    size_type count2) const
-    noexcept {
+template <class CharT, class Traits, class Allocator, class RefCount>
+int basic_string<CharT, Traits, Allocator, RefCount>::compare(
+    size_type pos1, size_type count1, const CharT* s,
+    size_type count2) const noexcept {
   const auto rlen = std::min(count1, count2);
   const auto res = Traits::compare(data() + pos1, s, rlen);
   if (res == 0) return count1 - count2;
   return res;
 }
 
+template <class CharT, class Traits, class Allocator, class RefCount>
+bool basic_string<CharT, Traits, Allocator, RefCount>::_equals(
+    const basic_string& str) const noexcept {
+  // the same header, or inline strings with the same characters
+  if (m_word == str.m_word) return true;
+  if (size() != str.size()) return false;
+
+  if (!_is_local() && !str._is_local()) {
+    const auto lhs = _header();
+    const auto rhs = str._header();
+    if (lhs->data == rhs->data) return true;
+    // hashes are of the bytes, so they only tell apart strings whose traits
+    // compare bytes as well
+    if (std::is_same<Traits, std::char_traits<CharT>>::value) {
+      const auto lhs_hash = lhs->hash.load(std::memory_order_relaxed);
+      const auto rhs_hash = rhs->hash.load(std::memory_order_relaxed);
+      if (lhs_hash != 0 && rhs_hash != 0 && lhs_hash != rhs_hash) {
+        return false;
+      }
+    }
+  }
+  return Traits::compare(data(), str.data(), size()) == 0;
+}
+
 // comparators
-template <class CharT, class Traits, class Alloc>
-bool operator==(const basic_string<CharT, Traits, Alloc>& lhs,
-                const basic_string<CharT, Traits, Alloc>& rhs) {
-  return lhs.size() == rhs.size() && lhs.compare(rhs) == 0;
+template <class CharT, class Traits, class Alloc, class RefCount>
+bool operator==(const basic_string<CharT, Traits, Alloc, RefCount>& lhs,
+                const basic_string<CharT, Traits, Alloc, RefCount>& rhs) {
+  return lhs._equals(rhs);
 }
 
-template <class CharT, class Traits, class Alloc>
-bool operator!=(const basic_string<CharT, Traits, Alloc>& lhs,
-                const basic_string<CharT, Traits, Alloc>& rhs) {
+template <class CharT, class Traits, class Alloc, class RefCount>
+bool operator!=(const basic_string<CharT, Traits, Alloc, RefCount>& lhs,
+                const basic_string<CharT, Traits, Alloc, RefCount>& rhs) {
   return !(lhs == rhs);
 }
 
-template <class CharT, class Traits, class Alloc>
-bool operator<(const basic_string<CharT, Traits, Alloc>& lhs,
-               const basic_string<CharT, Traits, Alloc>& rhs) {
+template <class CharT, class Traits, class Alloc, class RefCount>
+bool operator<(const basic_string<CharT, Traits, Alloc, RefCount>& lhs,
+               const basic_string<CharT, Traits, Alloc, RefCount>& rhs) {
   return lhs.compare(rhs) < 0;
 }
-template <class CharT, class Traits, class Alloc>
-bool operator<=(const basic_string<CharT, Traits, Alloc>& lhs,
-                const basic_string<CharT, Traits, Alloc>& rhs) {
+template <class CharT, class Traits, class Alloc, class RefCount>
+bool operator<=(const basic_string<CharT, Traits, Alloc, RefCount>& lhs,
+                const basic_string<CharT, Traits, Alloc, RefCount>& rhs) {
   return lhs.compare(rhs) <= 0;
 }
 
-template <class CharT, class Traits, class Alloc>
-bool operator>(const basic_string<CharT, Traits, Alloc>& lhs,
-               const basic_string<CharT, Traits, Alloc>& rhs) {
+template <class CharT, class Traits, class Alloc, class RefCount>
+bool operator>(const basic_string<CharT, Traits, Alloc, RefCount>& lhs,
+               const basic_string<CharT, Traits, Alloc, RefCount>& rhs) {
   return lhs.compare(rhs) > 0;
 }
 
-template <class CharT, class Traits, class Alloc>
-bool operator>=(const basic_string<CharT, Traits, Alloc>& lhs,
-                const basic_string<CharT, Traits, Alloc>& rhs) {
+template <class CharT, class Traits, class Alloc, class RefCount>
+bool operator>=(const basic_string<CharT, Traits, Alloc, RefCount>& lhs,
+                const basic_string<CharT, Traits, Alloc, RefCount>& rhs) {
   return lhs.compare(rhs) >= 0;
 }
 
-template <class CharT, class Traits, class Alloc>
-bool operator==(const basic_string<CharT, Traits, Alloc>& lhs,
+template <class CharT, class Traits, class Alloc, class RefCount>
+bool operator==(const basic_string<CharT, Traits, Alloc, RefCount>& lhs,
                 const CharT* rhs) {
   const auto rlen = Traits::length(rhs);
   return lhs.size() == rlen && lhs.compare(0, lhs.size(), rhs, rlen) == 0;
 }
-template <class CharT, class Traits, class Alloc>
-bool operator!=(const basic_string<CharT, Traits, Alloc>& lhs,
+template <class CharT, class Traits, class Alloc, class RefCount>
+bool operator!=(const basic_string<CharT, Traits, Alloc, RefCount>& lhs,
                 const CharT* rhs) {
   return !(lhs == rhs);
 }
 
-template <class CharT, class Traits, class Alloc>
+template <class CharT, class Traits, class Alloc, class RefCount>
 bool operator==(const CharT* lhs,
-                const basic_string<CharT, Traits, Alloc>& rhs) {
+                const basic_string<CharT, Traits, Alloc, RefCount>& rhs) {
   return rhs == lhs;
 }
-template <class CharT, class Traits, class Alloc>
+template <class CharT, class Traits, class Alloc, class RefCount>
 bool operator!=(const CharT* lhs,
-                const basic_string<CharT, Traits, Alloc>& rhs) {
+                const basic_string<CharT, Traits, Alloc, RefCount>& rhs) {
   return !(rhs == lhs);
 }
 
-template <class CharT, class Traits, class Alloc>
-bool operator<(const basic_string<CharT, Traits, Alloc>& lhs,
+template <class CharT, class Traits, class Alloc, class RefCount>
+bool operator<(const basic_string<CharT, Traits, Alloc, RefCount>& lhs,
                const CharT* rhs) {
   return lhs.compare(rhs) < 0;
 }
-template <class CharT, class Traits, class Alloc>
-bool operator<=(const basic_string<CharT, Traits, Alloc>& lhs,
+template <class CharT, class Traits, class Alloc, class RefCount>
+bool operator<=(const basic_string<CharT, Traits, Alloc, RefCount>& lhs,
                 const CharT* rhs) {
   return lhs.compare(rhs) <= 0;
 }
-template <class CharT, class Traits, class Alloc>
-bool operator>(const basic_string<CharT, Traits, Alloc>& lhs,
+template <class CharT, class Traits, class Alloc, class RefCount>
+bool operator>(const basic_string<CharT, Traits, Alloc, RefCount>& lhs,
                const CharT* rhs) {
   return lhs.compare(rhs) > 0;
 }
-template <class CharT, class Traits, class Alloc>
-bool operator>=(const basic_string<CharT, Traits, Alloc>& lhs,
+template <class CharT, class Traits, class Alloc, class RefCount>
+bool operator>=(const basic_string<CharT, Traits, Alloc, RefCount>& lhs,
                 const CharT* rhs) {
   return lhs.compare(rhs) >= 0;
 }
 
-template <class CharT, class Traits, class Alloc>
+template <class CharT, class Traits, class Alloc, class RefCount>
 bool operator<(const CharT* lhs,
-               const basic_string<CharT, Traits, Alloc>& rhs) {
+               const basic_string<CharT, Traits, Alloc, RefCount>& rhs) {
   return rhs > lhs;
 }
-template <class CharT, class Traits, class Alloc>
+template <class CharT, class Traits, class Alloc, class RefCount>
 bool operator<=(const CharT* lhs,
-                const basic_string<CharT, Traits, Alloc>& rhs) {
+                const basic_string<CharT, Traits, Alloc, RefCount>& rhs) {
   return rhs >= lhs;
 }
-template <class CharT, class Traits, class Alloc>
+template <class CharT, class Traits, class Alloc, class RefCount>
 bool operator>(const CharT* lhs,
-               const basic_string<CharT, Traits, Alloc>& rhs) {
+               const basic_string<CharT, Traits, Alloc, RefCount>& rhs) {
   return rhs < lhs;
 }
-template <class CharT, class Traits, class Alloc>
+template <class CharT, class Traits, class Alloc, class RefCount>
 bool operator>=(const CharT* lhs,
-                const basic_string<CharT, Traits, Alloc>& rhs) {
+                const basic_string<CharT, Traits, Alloc, RefCount>& rhs) {
   return rhs <= lhs;
 }
 
+inline namespace literals {
+
+// "content-type"_is is a string in static storage, see from_literal(). The
+// characters are passed as template arguments with a GNU extension available
+// since C++14; otherwise they are copied like the constructor does.
+#if defined(__GNUC__) && __cplusplus >= 201402L
+#define IMMUTABLE_STRING_STATIC_LITERALS 1
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+template <class CharT, CharT... Chars>
+basic_string<CharT> operator"" _is() noexcept {
+  return basic_string<CharT>::template from_literal<Chars...>();
+}
+#pragma GCC diagnostic pop
+#else
+inline string operator"" _is(const char* s, std::size_t count) {
+  return string(s, count);
+}
+inline wstring operator"" _is(const wchar_t* s, std::size_t count) {
+  return wstring(s, count);
+}
+#endif
+
+}  // namespace literals
+
 }  // namespace immutable_string
+
+namespace std {
+
+template <class CharT, class Allocator, class RefCount>
+struct hash<immutable_string::basic_string<CharT, std::char_traits<CharT>,
+                                           Allocator, RefCount>> {
+  std::size_t operator()(
+      const immutable_string::basic_string<CharT, std::char_traits<CharT>,
+                                           Allocator, RefCount>& str)
+      const noexcept {
+    return str.hash();
+  }
+};
+
+}  // namespace std
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+#include "intern_pool.hpp"
+
+namespace immutable_string {
+
+// A string interned in a pool shared by all symbols of its type, so that
+// equal symbols have equal ids: the header address of heap strings, the
+// characters themselves for inline ones. Symbols compare and hash by id
+// without touching the characters; otherwise they are plain strings and
+// convert to them for free.
+template <class CharT, class Traits = std::char_traits<CharT>,
+          class Allocator = std::allocator<CharT>,
+          class RefCount = atomic_refcount>
+class basic_symbol : public basic_string<CharT, Traits, Allocator, RefCount> {
+ public:
+  using string_type = basic_string<CharT, Traits, Allocator, RefCount>;
+  using pool_type = basic_intern_pool<CharT, Traits, Allocator, RefCount>;
+  using size_type = typename string_type::size_type;
+
+  basic_symbol() noexcept = default;
+  explicit basic_symbol(const string_type& str)
+      : string_type(pool().intern(str)) {}
+  explicit basic_symbol(const CharT* s) : string_type(pool().intern(s)) {}
+  basic_symbol(const CharT* s, size_type count)
+      : string_type(pool().intern(s, count)) {}
+
+  // Equal for symbols with the same characters, different otherwise.
+  std::uintptr_t id() const noexcept { return this->m_word; }
+
+  static pool_type& pool() {
+    static pool_type instance;
+    return instance;
+  }
+};
+
+using symbol = basic_symbol<char>;
+using wsymbol = basic_symbol<wchar_t>;
+
+template <class CharT, class Traits, class Alloc, class RefCount>
+bool operator==(const basic_symbol<CharT, Traits, Alloc, RefCount>& lhs,
+                const basic_symbol<CharT, Traits, Alloc, RefCount>& rhs) {
+  return lhs.id() == rhs.id();
+}
+template <class CharT, class Traits, class Alloc, class RefCount>
+bool operator!=(const basic_symbol<CharT, Traits, Alloc, RefCount>& lhs,
+                const basic_symbol<CharT, Traits, Alloc, RefCount>& rhs) {
+  return lhs.id() != rhs.id();
+}
+
+}  // namespace immutable_string
+
+namespace std {
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+struct hash<
+    immutable_string::basic_symbol<CharT, Traits, Allocator, RefCount>> {
+  std::size_t operator()(
+      const immutable_string::basic_symbol<CharT, Traits, Allocator,
+                                           RefCount>& sym) const noexcept {
+    return static_cast<std::size_t>(immutable_string::detail::wyhash::mix(
+        sym.id(), immutable_string::detail::wyhash::secret[0]));
+  }
+};
+
+}  // namespace std
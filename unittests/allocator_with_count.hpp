@@ -16,6 +16,9 @@ class allocator_with_count {
   using propagate_on_container_move_assignment = std::true_type;
 
   allocator_with_count(int& count) noexcept : m_allocated_count(count) {}
+  // counts deallocations too
+  allocator_with_count(int& count, int& deallocated_count) noexcept
+      : m_allocated_count(count), m_deallocated_count(&deallocated_count) {}
 
   allocator_with_count(const allocator_with_count&) noexcept = default;
   template <class U>
@@ -26,7 +29,8 @@ class allocator_with_count {
   friend class allocator_with_count;
   template <class U>
   allocator_with_count(const allocator_with_count<U>& other) noexcept
-      : m_allocated_count(other.m_allocated_count) {}
+      : m_allocated_count(other.m_allocated_count),
+        m_deallocated_count(other.m_deallocated_count) {}
 
   pointer address(reference x) const { return &x; }
   const_pointer address(const_reference x) const { return &x; }
@@ -39,7 +43,10 @@ class allocator_with_count {
   }
   T* allocate(std::size_t n, const void*) { return allocate(n); }
 
-  void deallocate(T* p, std::size_t) { ::operator delete(p); }
+  void deallocate(T* p, std::size_t) {
+    ::operator delete(p);
+    if (m_deallocated_count) ++*m_deallocated_count;
+  }
 
   std::size_t max_size() const noexcept {
     return std::numeric_limits<std::size_t>::max() / sizeof(T);
@@ -52,4 +59,17 @@ class allocator_with_count {
   void destroy(pointer p) { p->~T(); }
 
   int& m_allocated_count;
+  int* m_deallocated_count = nullptr;
 };
+
+// allocators counting into the same variables free each other's memory
+template <class T, class U>
+bool operator==(const allocator_with_count<T>& lhs,
+                const allocator_with_count<U>& rhs) noexcept {
+  return &lhs.m_allocated_count == &rhs.m_allocated_count;
+}
+template <class T, class U>
+bool operator!=(const allocator_with_count<T>& lhs,
+                const allocator_with_count<U>& rhs) noexcept {
+  return !(lhs == rhs);
+}
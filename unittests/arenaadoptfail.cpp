@@ -0,0 +1,15 @@
+// Shall not compile: an arena string is never freed, so the deleter of a
+// buffer it adopted would never run.
+#include "immutable_string/arena.hpp"
+
+#include <cstring>
+
+using namespace immutable_string;
+
+int main() {
+  static const char chars[] = "a string too long to be stored inline";
+  arena request_arena;
+  const arena_string str{adopt, chars, std::strlen(chars), [](const char*) {},
+                         request_arena};
+  return static_cast<int>(str.size());
+}
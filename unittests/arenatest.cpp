@@ -0,0 +1,142 @@
+#include "allocator_with_count.hpp"
+#include "catch2/catch.hpp"
+#include "fixtures.hpp"
+#include "immutable_string/arena.hpp"
+#include "immutable_string/builder.hpp"
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace immutable_string;
+
+using counted_arena = basic_arena<allocator_with_count<char>>;
+using counted_arena_string =
+    basic_arena_string<char, std::char_traits<char>,
+                       allocator_with_count<char>>;
+
+static_assert(sizeof(arena_string) == sizeof(void*),
+              "arena string shall be one pointer wide");
+static_assert(!uncounted_refcount::frees_strings,
+              "arena strings shall not adopt buffers, which are never freed");
+static_assert(atomic_refcount::frees_strings && biased_refcount::frees_strings,
+              "counted strings shall adopt buffers");
+
+SCENARIO("arena strings are bump-allocated from chunks", "[arena]") {
+  GIVEN("arena taking chunks from a counting allocator") {
+    int allocated_count = 0;
+    int deallocated_count = 0;
+    counted_arena arena(1 << 16, allocator_with_count<char>{
+                                     allocated_count, deallocated_count});
+
+    WHEN("many strings are made") {
+      std::vector<counted_arena_string> strings;
+      for (int i = 0; i < 100; ++i) {
+        strings.emplace_back((std::to_string(i) + long_cstr).c_str(), arena);
+      }
+
+      THEN("they share one chunk") {
+        REQUIRE(allocated_count == 1);
+        REQUIRE(strings[42] == (std::string("42") + long_cstr).c_str());
+        REQUIRE(strings[99].substr(2) == long_cstr);
+      }
+
+      THEN("arena is released at once") {
+        REQUIRE(deallocated_count == 0);
+        arena.release();
+        REQUIRE(allocated_count == 1);
+        REQUIRE(deallocated_count == 1);
+
+        const counted_arena_string str{long_cstr, arena};
+        REQUIRE(allocated_count == 2);
+        REQUIRE(str == long_cstr);
+      }
+    }
+
+    WHEN("strings fill several chunks") {
+      const std::string chars(1000, 'x');
+      std::vector<counted_arena_string> strings;
+      for (int i = 0; i < 200; ++i) strings.emplace_back(chars.c_str(), arena);
+      REQUIRE(allocated_count > 1);
+
+      THEN("each chunk is deallocated once") {
+        strings.clear();
+        REQUIRE(deallocated_count == 0);
+        arena.release();
+        REQUIRE(deallocated_count == allocated_count);
+        arena.release();
+        REQUIRE(deallocated_count == allocated_count);
+      }
+    }
+
+    WHEN("a string is longer than a chunk") {
+      const std::string chars(100000, 'x');
+      const counted_arena_string str{chars.c_str(), arena};
+
+      THEN("it gets a chunk of its own") {
+        REQUIRE(allocated_count == 1);
+        REQUIRE(str.size() == 100000);
+        REQUIRE(str.find('y') == counted_arena_string::npos);
+      }
+    }
+  }
+}
+
+SCENARIO("arena strings are not reference counted", "[arena]") {
+  GIVEN("arena string") {
+    arena request_arena;
+    const arena_string str{long_cstr, request_arena};
+
+    WHEN("it is copied and sliced") {
+      const arena_string copy = str;
+      const arena_string slice = str.substr(2, 20);
+
+      THEN("copies share the characters without counting") {
+        REQUIRE(copy.data() == str.data());
+        REQUIRE(copy.use_count() == 0);
+        REQUIRE(slice.data() == str.data() + 2);
+        REQUIRE(std::string(slice.c_str()) == "string too long to b");
+      }
+    }
+  }
+}
+
+SCENARIO("arena strings are concatenated in their arena", "[arena]") {
+  GIVEN("arena strings") {
+    int allocated_count = 0;
+    counted_arena arena(1 << 16, allocator_with_count<char>{allocated_count});
+    const counted_arena_string str{long_cstr, arena};
+    const counted_arena_string short_str{"abc", arena};
+    REQUIRE(allocated_count == 1);
+
+    THEN("the result takes the arena of the first string") {
+      const counted_arena_string joined = concat(str, '/', short_str);
+      const counted_arena_string chain = str + '/' + short_str;
+      REQUIRE(joined == chain);
+      REQUIRE(chain.size() == str.size() + 4);
+      REQUIRE(("<" + str).str() == (std::string("<") + long_cstr).c_str());
+      REQUIRE(allocated_count == 1);
+    }
+    THEN("an inline first string takes the arena of a later one") {
+      const counted_arena_string joined = concat(short_str, '/', str);
+      const counted_arena_string chain = short_str + "/" + str;
+      REQUIRE(joined == chain);
+      REQUIRE(joined.size() == str.size() + 4);
+      REQUIRE(joined.get_allocator().arena() == &arena);
+      REQUIRE(chain.get_allocator().arena() == &arena);
+      REQUIRE(allocated_count == 1);
+    }
+    THEN("inline strings take an arena given with them") {
+      const arena_allocator<char, allocator_with_count<char>> alloc(arena);
+      const auto joined =
+          concat(std::allocator_arg, alloc, short_str, short_str, short_str);
+      REQUIRE(joined == "abcabcabc");
+      REQUIRE(joined.get_allocator().arena() == &arena);
+      REQUIRE((short_str + short_str + short_str).str(alloc) == joined);
+      REQUIRE_THROWS_AS(concat(short_str, short_str, short_str),
+                        std::invalid_argument);
+      REQUIRE(allocated_count == 1);
+    }
+  }
+}
@@ -0,0 +1,200 @@
+#include "allocator_with_count.hpp"
+#include "catch2/catch.hpp"
+#include "immutable_string/builder.hpp"
+#include "immutable_string/symbol.hpp"
+
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+using namespace immutable_string;
+
+using string_count_alloc =
+    basic_string<char, std::char_traits<char>, allocator_with_count<char>>;
+using builder_count_alloc =
+    basic_string_builder<char, std::char_traits<char>,
+                         allocator_with_count<char>>;
+
+SCENARIO("builder writes a string into its final buffer", "[builder]") {
+  int allocated_count = 0;
+  auto allocator = allocator_with_count<char>{allocated_count};
+
+  GIVEN("builder of a long string") {
+    const auto total = std::strlen("https://example.com/index.html");
+    builder_count_alloc builder(total, allocator);
+    REQUIRE(allocated_count == 1);
+    REQUIRE(builder.capacity() == total);
+
+    WHEN("it is filled") {
+      const std::string scheme = "https";
+      const string_count_alloc host{"example.com", allocator};
+      builder.append(scheme).append("://").append(host).append('/');
+      builder.append("index.html", 10);
+      REQUIRE(builder.size() == total);
+      const auto url = builder.build();
+
+      THEN("the buffer is handed over") {
+        REQUIRE(url == "https://example.com/index.html");
+        REQUIRE(std::strcmp(url.c_str(), "https://example.com/index.html") ==
+                0);
+        REQUIRE(allocated_count == 2);
+        REQUIRE(url.use_count() == 1);
+      }
+      THEN("the builder is left empty") {
+        REQUIRE(builder.size() == 0);
+        REQUIRE(builder.capacity() == 0);
+        REQUIRE(builder.build().empty());
+      }
+    }
+    WHEN("it is filled partially") {
+      builder.append("https://example.com/");
+      const auto url = builder.build();
+
+      THEN("the characters are copied into a buffer of their own") {
+        REQUIRE(url == "https://example.com/");
+        REQUIRE(std::strcmp(url.c_str(), "https://example.com/") == 0);
+        REQUIRE(allocated_count == 2);
+      }
+    }
+    WHEN("it is overfilled") {
+      builder.append("https://example.com/");
+
+      THEN("append throws") {
+        REQUIRE_THROWS_AS(builder.append("index.html!"), std::length_error);
+        REQUIRE(builder.size() == std::strlen("https://example.com/"));
+      }
+    }
+  }
+
+  GIVEN("builder of a short string") {
+    builder_count_alloc builder(3, allocator);
+    builder.append("GET");
+
+    THEN("nothing is allocated") {
+      REQUIRE(builder.build() == "GET");
+      REQUIRE(allocated_count == 0);
+    }
+  }
+}
+
+namespace {
+
+// Default constructible, unlike allocator_with_count, as concat makes its
+// allocator.
+int global_allocated_count = 0;
+
+template <class T>
+struct global_count_allocator : std::allocator<T> {
+  template <class U>
+  struct rebind {
+    using other = global_count_allocator<U>;
+  };
+
+  global_count_allocator() = default;
+  template <class U>
+  global_count_allocator(const global_count_allocator<U>&) noexcept {}
+
+  T* allocate(std::size_t n) {
+    ++global_allocated_count;
+    return std::allocator<T>::allocate(n);
+  }
+};
+
+}  // namespace
+
+SCENARIO("concat allocates once", "[builder]") {
+  using string_global_count =
+      basic_string<char, std::char_traits<char>, global_count_allocator<char>>;
+  global_allocated_count = 0;
+
+  GIVEN("pieces of different kinds") {
+    const string_global_count tenant{"tenant-0123456789"};
+    const std::string id = "42";
+    const char separator = '/';
+    REQUIRE(global_allocated_count == 1);
+
+    THEN("they are joined in one buffer") {
+      const auto key = concat(tenant, separator, "users", '/', id);
+      REQUIRE(key == "tenant-0123456789/users/42");
+      REQUIRE(global_allocated_count == 2);
+    }
+    THEN("a single piece is copied") {
+      REQUIRE(concat(tenant) == tenant);
+    }
+  }
+
+  GIVEN("short pieces") {
+    const string a{"a"};
+
+    THEN("the result is inline") {
+      REQUIRE(concat(a, "b", 'c') == "abc");
+      REQUIRE(concat(a, "bcdefgh") == "abcdefgh");
+      REQUIRE(concat(string{}, "") == "");
+    }
+  }
+
+  GIVEN("wide pieces") {
+    const wstring wide{L"wide"};
+
+    THEN("they are joined by their traits") {
+      REQUIRE(concat(wide, L' ', std::wstring{L"string"}) == L"wide string");
+    }
+  }
+}
+
+SCENARIO("operator+ is evaluated lazily", "[builder]") {
+  using string_global_count =
+      basic_string<char, std::char_traits<char>, global_count_allocator<char>>;
+  global_allocated_count = 0;
+
+  GIVEN("chain of operands") {
+    const string_global_count root{"/var/lib/service"};
+    const string_global_count name{"state.json"};
+    const std::string dir = "data";
+    REQUIRE(global_allocated_count == 2);
+
+    THEN("it is not a string until converted") {
+      const auto chain = root + '/' + dir;
+      REQUIRE_FALSE((std::is_same<decltype(chain),
+                                  const string_global_count>::value));
+      REQUIRE(chain.size() == root.size() + 1 + dir.size());
+      REQUIRE(global_allocated_count == 2);
+    }
+    THEN("it is written into one buffer") {
+      const string_global_count path = root + '/' + dir + "/" + name;
+      REQUIRE(path == "/var/lib/service/data/state.json");
+      REQUIRE(global_allocated_count == 3);
+    }
+    THEN("operands may come before a string") {
+      const string_global_count path = "file://" + root + '/';
+      REQUIRE(path == "file:///var/lib/service/");
+      REQUIRE(('<' + root).str() == "</var/lib/service");
+      REQUIRE((dir + name).str() == "datastate.json");
+    }
+  }
+
+  GIVEN("short operands") {
+    const string a{"a"};
+
+    THEN("the result is inline") {
+      const string str = a + a + 'b';
+      REQUIRE(str == "aab");
+      REQUIRE(str.use_count() == 1);
+    }
+  }
+
+  GIVEN("symbols") {
+    const symbol tenant{"tenant"};
+    const symbol users{"users"};
+
+    THEN("they are concatenated as strings") {
+      const string key = tenant + users;
+      REQUIRE(key == "tenantusers");
+      REQUIRE((tenant + '/' + users).str() == "tenant/users");
+      REQUIRE(("/" + tenant).str() == "/tenant");
+    }
+  }
+}
@@ -0,0 +1,121 @@
+#include "catch2/catch.hpp"
+#include "immutable_string/epoch.hpp"
+
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace immutable_string;
+
+namespace {
+
+std::atomic<int> freed_count{0};
+
+// Adopts a copy of `s`, counting the buffers freed.
+string make_counted(const std::string& s) {
+  const auto chars = new char[s.size()];
+  std::memcpy(chars, s.data(), s.size());
+  return string{adopt, chars, s.size(), [](const char* p) {
+                  delete[] p;
+                  ++freed_count;
+                }};
+}
+
+// made before the epoch state, so destroyed after it, which retires the
+// string at exit
+published<string> global_config{string{"a global string too long to inline"}};
+
+}  // namespace
+
+SCENARIO("published strings are read without copying", "[epoch]") {
+  GIVEN("published string") {
+    published<string> config{string{"a string too long to be stored inline"}};
+
+    THEN("readers borrow it under a guard") {
+      epoch::guard guard;
+      const auto& current = config.load(guard);
+      REQUIRE(current == "a string too long to be stored inline");
+      REQUIRE(current.use_count() == 1);
+      REQUIRE(&config.load(guard) == &current);
+    }
+    THEN("guards nest") {
+      epoch::guard outer;
+      {
+        epoch::guard inner;
+        REQUIRE(config.load(inner).size() == 37);
+      }
+      REQUIRE(config.load(outer).size() == 37);
+    }
+    THEN("namespace-scope strings are published too") {
+      epoch::guard guard;
+      const auto& current = global_config.load(guard);
+      REQUIRE(current == "a global string too long to inline");
+    }
+    THEN("a copy outlives the guard") {
+      const auto copy = config.copy();
+      REQUIRE(copy.use_count() == 2);
+      config.store(string{"another string too long to be inline"});
+      REQUIRE(copy == "a string too long to be stored inline");
+    }
+  }
+}
+
+SCENARIO("retired strings are freed after readers leave", "[epoch]") {
+  // strings retired by earlier runs are not counted
+  for (int i = 0; i < 3; ++i) epoch::collect();
+  freed_count = 0;
+
+  GIVEN("string read while it is replaced") {
+    published<string> config{make_counted("first version of the config")};
+    std::unique_ptr<epoch::guard> guard{new epoch::guard};
+    const auto& first = config.load(*guard);
+    config.store(make_counted("second version of the config"));
+
+    THEN("it is kept until the guard is left") {
+      for (int i = 0; i < 3; ++i) epoch::collect();
+      REQUIRE(freed_count == 0);
+      REQUIRE(first == "first version of the config");
+
+      guard.reset();
+      for (int i = 0; i < 3; ++i) epoch::collect();
+      REQUIRE(freed_count == 1);
+    }
+  }
+
+  GIVEN("readers on other threads") {
+    const int versions = 1000;
+    {
+      published<string> config{make_counted("version 0 of the config")};
+      std::atomic<bool> done{false};
+      std::atomic<int> mismatches{0};
+      std::vector<std::thread> readers;
+      for (int i = 0; i < 4; ++i) {
+        readers.emplace_back([&config, &done, &mismatches] {
+          while (!done) {
+            epoch::guard guard;
+            const auto& current = config.load(guard);
+            if (current.compare(0, 8, "version ") != 0 ||
+                current.find(" of the config") == string::npos) {
+              ++mismatches;
+            }
+          }
+        });
+      }
+      for (int i = 1; i <= versions; ++i) {
+        config.store(make_counted("version " + std::to_string(i) +
+                                  " of the config"));
+      }
+      done = true;
+      for (auto& reader : readers) reader.join();
+      REQUIRE(mismatches == 0);
+    }
+
+    THEN("every version is freed once no reader is left") {
+      for (int i = 0; i < 3; ++i) epoch::collect();
+      REQUIRE(freed_count == versions + 1);
+    }
+  }
+}
@@ -0,0 +1,175 @@
+#include "catch2/catch.hpp"
+#include "fixtures.hpp"
+#include "immutable_string/detail/find.hpp"
+#include "immutable_string/string.hpp"
+
+#include <cstddef>
+#include <random>
+#include <string>
+
+using namespace immutable_string;
+
+namespace {
+
+using find_char_kernel = std::size_t (*)(const char*, std::size_t, char);
+using find_kernel = std::size_t (*)(const char*, std::size_t, const char*,
+                                    std::size_t);
+
+std::size_t expected_find(const std::string& haystack,
+                          const std::string& needle) {
+  const auto found = haystack.find(needle);
+  return found == std::string::npos ? detail::not_found : found;
+}
+
+// Places the needle at every offset of haystacks crossing a few vector widths,
+// after a partial match that only differs in the middle.
+void require_finds(find_char_kernel find_char, find_kernel find) {
+  for (std::size_t size = 0; size <= 80; ++size) {
+    for (std::size_t pos = 0; pos < size; ++pos) {
+      std::string haystack(size, 'a');
+      haystack[pos] = 'b';
+      REQUIRE(find_char(haystack.data(), size, 'b') == pos);
+      REQUIRE(find_char(haystack.data(), pos, 'b') == detail::not_found);
+    }
+  }
+
+  for (std::size_t count = 2; count <= 40; ++count) {
+    std::string needle(count, 'n');
+    needle.front() = 'f';
+    needle.back() = 'l';
+    auto near_miss = needle;
+    if (count > 2) near_miss[count / 2] = 'x';
+
+    for (std::size_t size = count; size <= 80; ++size) {
+      for (std::size_t pos = 0; pos + count <= size; ++pos) {
+        std::string haystack(size, 'n');
+        if (pos >= count) haystack.replace(0, count, near_miss);
+        haystack.replace(pos, count, needle);
+        REQUIRE(find(haystack.data(), size, needle.data(), count) ==
+                expected_find(haystack, needle));
+        REQUIRE(find(haystack.data(), size - 1, needle.data(), count) ==
+                expected_find(haystack.substr(0, size - 1), needle));
+      }
+    }
+  }
+}
+
+}  // namespace
+
+SCENARIO("find kernels agree with std::string::find", "[find]") {
+  GIVEN("scalar kernels") {
+    require_finds(&detail::find_char_scalar, &detail::find_scalar);
+  }
+
+  GIVEN("dispatched kernels") {
+    require_finds(&detail::find_char, &detail::find);
+  }
+
+#if defined(IMMUTABLE_STRING_X86_SIMD)
+  GIVEN("SSE2 kernels") {
+    require_finds(&detail::find_char_sse2, &detail::find_sse2);
+  }
+
+  if (detail::has_avx2()) {
+    GIVEN("AVX2 kernels") {
+      require_finds(&detail::find_char_avx2, &detail::find_avx2);
+    }
+  }
+#endif
+}
+
+SCENARIO("two-way search agrees with std::string::find", "[find]") {
+  GIVEN("every needle over a two-letter alphabet up to 10 characters") {
+    std::mt19937 random(42);
+    std::string haystack(500, 'a');
+    for (auto& ch : haystack) ch = random() % 2 ? 'a' : 'b';
+
+    for (std::size_t count = 1; count <= 10; ++count) {
+      for (unsigned bits = 0; bits < 1u << count; ++bits) {
+        std::string needle;
+        for (std::size_t i = 0; i < count; ++i) {
+          needle += bits & (1u << i) ? 'b' : 'a';
+        }
+        const detail::two_way<char, std::char_traits<char>> searcher(
+            needle.data(), count);
+        REQUIRE(searcher.find(needle.data(), haystack.data(),
+                              haystack.size()) ==
+                expected_find(haystack, needle));
+      }
+    }
+  }
+
+  GIVEN("periodic needles") {
+    const std::string haystack = std::string(1000, 'a') + "b" +
+                                 std::string(1000, 'a') + "abaabaaba";
+    const std::string needles[] = {"aab", "aaba", "abaaba", "aaaaab",
+                                   "abaabaaba", std::string(500, 'a') + "b"};
+    for (const auto& needle : needles) {
+      const detail::two_way<char, std::char_traits<char>> searcher(
+          needle.data(), needle.size());
+      REQUIRE(searcher.find(needle.data(), haystack.data(),
+                            haystack.size()) ==
+              expected_find(haystack, needle));
+    }
+  }
+}
+
+SCENARIO("long needles are searched in linear time", "[find]") {
+  using counted_string = basic_string<char, counting_traits>;
+
+  GIVEN("repetitive haystack and a needle sharing its prefixes") {
+    const std::size_t size = 100000;
+    const counted_string haystack(size, 'a');
+    const std::string needle = std::string(1000, 'a') + "b";
+
+    WHEN("it is searched") {
+      counting_traits::comparisons() = 0;
+      const auto found = haystack.find(needle.c_str());
+
+      THEN("every character is compared a bounded number of times") {
+        REQUIRE(found == counted_string::npos);
+        REQUIRE(counting_traits::comparisons() <= 2 * size + 4 * needle.size());
+      }
+    }
+  }
+}
+
+SCENARIO("vectorized kernels hand repetitive text over to two-way", "[find]") {
+  GIVEN("needle whose first and last characters match everywhere") {
+    const std::string needle =
+        std::string(500, 'a') + "b" + std::string(500, 'a');
+    const std::string text =
+        std::string(20000, 'a') + "b" + std::string(20000, 'a');
+    const auto expected = text.find(needle);
+    const string str(text.data(), text.size());
+
+    THEN("it is found past the point where the filter gives up") {
+      REQUIRE(detail::find(text.data(), text.size(), needle.data(),
+                           needle.size()) == expected);
+      REQUIRE(str.find(needle.c_str()) == expected);
+      REQUIRE(str.find(needle.c_str(), expected + 1) == string::npos);
+    }
+
+#if defined(IMMUTABLE_STRING_X86_SIMD)
+    THEN("the SSE2 kernel gives up within its budget") {
+      std::size_t stop = 0;
+      REQUIRE(detail::find_sse2(text.data(), text.size(), needle.data(),
+                                needle.size(), stop) == detail::not_found);
+      REQUIRE(stop < expected);
+      REQUIRE(detail::find_sse2(text.data(), text.size(), needle.data(),
+                                needle.size()) == expected);
+    }
+
+    if (detail::has_avx2()) {
+      THEN("the AVX2 kernel gives up within its budget") {
+        std::size_t stop = 0;
+        REQUIRE(detail::find_avx2(text.data(), text.size(), needle.data(),
+                                  needle.size(), stop) == detail::not_found);
+        REQUIRE(stop < expected);
+        REQUIRE(detail::find_avx2(text.data(), text.size(), needle.data(),
+                                  needle.size()) == expected);
+      }
+    }
+#endif
+  }
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// too long to be stored inline
+static const char* const long_cstr = "a string too long to be stored inline";
+
+// Counts character comparisons, to check that searches stay linear or that
+// equality does not touch the characters at all.
+struct counting_traits : std::char_traits<char> {
+  static std::size_t& comparisons() noexcept {
+    static std::size_t count = 0;
+    return count;
+  }
+
+  static bool eq(char a, char b) noexcept {
+    ++comparisons();
+    return a == b;
+  }
+  static bool lt(char a, char b) noexcept {
+    ++comparisons();
+    return static_cast<unsigned char>(a) < static_cast<unsigned char>(b);
+  }
+  static int compare(const char* s1, const char* s2, std::size_t n) noexcept {
+    for (std::size_t i = 0; i < n; ++i) {
+      if (lt(s1[i], s2[i])) return -1;
+      if (lt(s2[i], s1[i])) return 1;
+    }
+    return 0;
+  }
+  static const char* find(const char* s, std::size_t n, char ch) noexcept {
+    for (std::size_t i = 0; i < n; ++i) {
+      if (eq(s[i], ch)) return s + i;
+    }
+    return nullptr;
+  }
+};
@@ -0,0 +1,192 @@
+#include "allocator_with_count.hpp"
+#include "catch2/catch.hpp"
+#include "fixtures.hpp"
+#include "immutable_string/intern_pool.hpp"
+
+#include <cstring>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace immutable_string;
+
+SCENARIO("intern pool returns canonical strings", "[intern]") {
+  GIVEN("pool") {
+    intern_pool pool;
+
+    WHEN("equal strings are interned") {
+      const auto first = pool.intern(string{long_cstr});
+      const auto second = pool.intern(string{long_cstr});
+      const auto third = pool.intern(long_cstr);
+
+      THEN("they share one buffer") {
+        REQUIRE(first == long_cstr);
+        REQUIRE(second.data() == first.data());
+        REQUIRE(third.data() == first.data());
+        REQUIRE(pool.size() == 1);
+      }
+
+      THEN("statistics count the hits") {
+        const auto stats = pool.stats();
+        REQUIRE(stats.lookups == 3);
+        REQUIRE(stats.hits == 2);
+        REQUIRE(stats.entries == 1);
+        REQUIRE(stats.bytes_saved == 2 * std::strlen(long_cstr));
+        REQUIRE(stats.hit_rate() == Approx(2.0 / 3));
+      }
+    }
+
+    WHEN("different strings are interned") {
+      const auto first = pool.intern(long_cstr);
+      const auto second = pool.intern("another string too long to be inline");
+
+      THEN("each gets its own entry") {
+        REQUIRE(first.data() != second.data());
+        REQUIRE(pool.size() == 2);
+        REQUIRE(pool.stats().hits == 0);
+      }
+    }
+
+    WHEN("short strings are interned") {
+      const auto str = pool.intern("abc");
+
+      THEN("they stay inline and out of the pool") {
+        REQUIRE(str == "abc");
+        REQUIRE(pool.intern(string{"abc"}) == "abc");
+        REQUIRE(pool.size() == 0);
+        REQUIRE(pool.stats().lookups == 0);
+      }
+    }
+  }
+}
+
+SCENARIO("intern pool does not keep strings alive", "[intern]") {
+  GIVEN("pool with counted allocations") {
+    int allocated_count = 0;
+    using counted_pool =
+        basic_intern_pool<char, std::char_traits<char>,
+                          allocator_with_count<char>>;
+    using counted_string = counted_pool::string_type;
+    const auto allocator = allocator_with_count<char>{allocated_count};
+    counted_pool pool(allocator);
+
+    WHEN("a substring is interned") {
+      const counted_string parent{
+          "prefix: a string too long to be stored inline", allocator};
+      const auto interned = pool.intern(parent.substr(8));
+
+      THEN("the pool stores a compacted copy") {
+        REQUIRE(interned == long_cstr);
+        REQUIRE(interned.use_count() == 2);
+        REQUIRE(parent.use_count() == 1);
+      }
+    }
+
+    WHEN("an adopted buffer is interned") {
+      int deleted_count = 0;
+      auto deleter = [&deleted_count](const char*) { ++deleted_count; };
+      auto adopted = counted_string{adopt, long_cstr, std::strlen(long_cstr),
+                                    deleter, allocator};
+      const auto interned = pool.intern(adopted);
+
+      THEN("the pool stores a copy and releases the buffer") {
+        REQUIRE(interned == long_cstr);
+        REQUIRE(interned.data() != long_cstr);
+        REQUIRE(adopted.use_count() == 1);
+        adopted = counted_string{};
+        REQUIRE(deleted_count == 1);
+        REQUIRE(pool.intern(long_cstr).data() == interned.data());
+      }
+    }
+
+    WHEN("strings of the pool's allocator and of another are interned") {
+      int other_count = 0;
+      const counted_string own{long_cstr, allocator};
+      const counted_string other{"another string too long to be inline",
+                                 allocator_with_count<char>{other_count}};
+      const auto interned_own = pool.intern(own);
+      const auto interned_other = pool.intern(other);
+
+      THEN("only the other is copied, into the pool's allocator") {
+        REQUIRE(interned_own.data() == own.data());
+        REQUIRE(interned_other == other);
+        REQUIRE(interned_other.data() != other.data());
+        REQUIRE(interned_other.get_allocator() == allocator);
+        REQUIRE(other_count == 1);
+        REQUIRE(allocated_count == 2);
+      }
+    }
+
+    WHEN("nothing but the pool references an entry") {
+      pool.intern(long_cstr);
+      const auto kept = pool.intern("another string too long to be inline");
+
+      THEN("reclaim drops it") {
+        REQUIRE(pool.reclaim() == 1);
+        REQUIRE(pool.size() == 1);
+        REQUIRE(pool.stats().reclaimed == 1);
+        REQUIRE(pool.intern(kept).data() == kept.data());
+      }
+    }
+
+    WHEN("many unreferenced entries are interned") {
+      for (int i = 0; i < 10000; ++i) {
+        pool.intern((std::to_string(i) + long_cstr).c_str());
+      }
+
+      THEN("shards drop them as they grow") {
+        REQUIRE(pool.size() < 10000);
+        REQUIRE(pool.stats().reclaimed + pool.size() == 10000);
+      }
+    }
+  }
+}
+
+SCENARIO("intern pool is shared between threads", "[intern]") {
+  GIVEN("threads interning the same strings") {
+    intern_pool pool(std::allocator<char>{}, 4);
+    std::vector<std::vector<string>> results(4);
+    std::vector<std::thread> threads;
+    for (auto& result : results) {
+      threads.emplace_back([&pool, &result] {
+        for (int i = 0; i < 1000; ++i) {
+          result.push_back(
+              pool.intern((std::to_string(i % 100) + long_cstr).c_str()));
+        }
+      });
+    }
+    for (auto& thread : threads) thread.join();
+
+    THEN("every thread gets the same canonical strings") {
+      for (int i = 0; i < 1000; ++i) {
+        REQUIRE(results[1][i].data() == results[0][i].data());
+        REQUIRE(results[2][i].data() == results[0][i].data());
+        REQUIRE(results[3][i].data() == results[0][i].data());
+      }
+      REQUIRE(pool.size() == 100);
+      REQUIRE(pool.stats().hits == 3900);
+    }
+  }
+  GIVEN("entry held by another thread") {
+    intern_pool pool;
+    std::promise<const char*> interned;
+    std::promise<void> swept;
+    std::thread thread([&pool, &interned, &swept] {
+      const auto held = pool.intern(long_cstr);
+      interned.set_value(held.data());
+      swept.get_future().wait();
+    });
+    const auto held_data = interned.get_future().get();
+
+    const auto reclaimed = pool.reclaim();
+    const auto again = pool.intern(long_cstr);
+    swept.set_value();
+    thread.join();
+
+    THEN("sweeping keeps it") {
+      REQUIRE(reclaimed == 0);
+      REQUIRE(again.data() == held_data);
+    }
+  }
+}
@@ -0,0 +1,66 @@
+#include "catch2/catch.hpp"
+#include "fixtures.hpp"
+#include "immutable_string/string.hpp"
+
+#include <cstring>
+
+using namespace immutable_string;
+
+// Built as C++14, where the suffix takes the characters as template arguments
+// on GCC and Clang.
+#if defined(__GNUC__) && !defined(IMMUTABLE_STRING_STATIC_LITERALS)
+#error "static literals shall be available in C++14 on GCC and Clang"
+#endif
+
+#ifdef IMMUTABLE_STRING_STATIC_LITERALS
+
+namespace {
+
+// made before the tests run, in no particular order with the literal header
+const string literal_at_init = "a string too long to be stored inline"_is;
+
+}  // namespace
+
+SCENARIO("literals written with the suffix are static", "[literal]") {
+  GIVEN("long literal") {
+    const auto str = "a string too long to be stored inline"_is;
+
+    THEN("it references static storage") {
+      REQUIRE(str == long_cstr);
+      REQUIRE(str.data() == "a string too long to be stored inline"_is.data());
+      REQUIRE(str.c_str() == str.data());
+      REQUIRE(str.use_count() == 0);
+    }
+    THEN("equal literals share it") {
+      REQUIRE(literal_at_init.data() == str.data());
+    }
+    THEN("its copies and substrings are not counted") {
+      const auto copy = str;
+      REQUIRE(copy.data() == str.data());
+      REQUIRE(str.use_count() == 0);
+      const auto sub = str.substr(2, 15);
+      REQUIRE(sub.data() == str.data() + 2);
+      REQUIRE(std::strcmp(sub.c_str(), "string too long") == 0);
+    }
+  }
+
+  GIVEN("wide literal") {
+    const auto str = L"a wide string too long to be stored inline"_is;
+
+    THEN("it references static storage") {
+      REQUIRE(str == L"a wide string too long to be stored inline");
+      REQUIRE(str.data() ==
+              L"a wide string too long to be stored inline"_is.data());
+      REQUIRE(str.use_count() == 0);
+    }
+  }
+
+  GIVEN("short literal") {
+    THEN("it is stored inline") {
+      REQUIRE("GET"_is == "GET");
+      REQUIRE("GET"_is.use_count() == 1);
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,110 @@
+#include "catch2/catch.hpp"
+#include "immutable_string/matcher.hpp"
+
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace immutable_string;
+
+namespace {
+
+using found = std::vector<std::pair<std::size_t, std::size_t>>;
+
+template <class Matcher>
+found find_all(const Matcher& m, const typename Matcher::string_type& text) {
+  found result;
+  for (const auto& match : m.find_all(text)) {
+    result.emplace_back(match.pattern, match.pos);
+  }
+  return result;
+}
+
+}  // namespace
+
+SCENARIO("matcher reports every occurrence of its patterns", "[matcher]") {
+  GIVEN("overlapping patterns") {
+    const matcher keywords{string{"he"}, string{"she"}, string{"his"},
+                           string{"hers"}};
+    REQUIRE(keywords.size() == 4);
+    REQUIRE(keywords.pattern(3) == "hers");
+
+    THEN("matches are ordered by their ends, longer ones first") {
+      REQUIRE(find_all(keywords, string{"ushers"}) ==
+              found({{1, 1}, {0, 2}, {3, 2}}));
+      REQUIRE(find_all(keywords, string{"this is his"}) ==
+              found({{2, 1}, {2, 8}}));
+      REQUIRE(find_all(keywords, string{"nothing here"}) ==
+              found({{0, 8}}));
+      REQUIRE(find_all(keywords, string{"xyz"}).empty());
+      REQUIRE(find_all(keywords, string{}).empty());
+    }
+
+    THEN("membership is checked without collecting matches") {
+      REQUIRE(keywords.contains_any(string{"a shell"}));
+      REQUIRE(!keywords.contains_any(string{"a shall"}));
+    }
+  }
+
+  GIVEN("duplicate and empty patterns") {
+    const matcher keywords{string{"ab"}, string{}, string{"ab"},
+                           string{"b"}};
+
+    THEN("duplicates match each, empty ones never") {
+      REQUIRE(find_all(keywords, string{"abab"}) ==
+              found({{2, 0}, {0, 0}, {3, 1}, {2, 2}, {0, 2}, {3, 3}}));
+    }
+  }
+
+  GIVEN("patterns starting with the same character") {
+    const matcher keywords{string{"#include"}, string{"#in"},
+                           string{"#define"}};
+
+    THEN("the text between matches is skipped") {
+      REQUIRE(find_all(keywords, string{"x #define y #include z #i"}) ==
+              found({{2, 2}, {1, 12}, {0, 12}}));
+    }
+  }
+
+  GIVEN("wide patterns") {
+    const wmatcher keywords{wstring{L"wide"}, wstring{L"ide"}};
+
+    THEN("they are matched with the character traits") {
+      REQUIRE(find_all(keywords, wstring{L"a wide side"}) ==
+              found({{0, 2}, {1, 3}, {1, 8}}));
+    }
+  }
+}
+
+SCENARIO("matcher agrees with repeated find", "[matcher]") {
+  GIVEN("random patterns over a small alphabet") {
+    std::mt19937 random(7);
+    const auto random_string = [&random](std::size_t size) {
+      std::string result(size, 'a');
+      for (auto& ch : result) ch = static_cast<char>('a' + random() % 3);
+      return result;
+    };
+
+    std::vector<string> patterns;
+    for (int i = 0; i < 50; ++i) {
+      patterns.emplace_back(random_string(1 + random() % 6).c_str());
+    }
+    const matcher keywords(patterns.begin(), patterns.end());
+    const string text{random_string(2000).c_str()};
+
+    THEN("every occurrence of every pattern is reported once") {
+      found expected;
+      for (std::size_t i = 0; i < patterns.size(); ++i) {
+        for (auto pos = text.find(patterns[i]); pos != string::npos;
+             pos = text.find(patterns[i], pos + 1)) {
+          expected.emplace_back(i, pos);
+        }
+      }
+      auto actual = find_all(keywords, text);
+      std::sort(expected.begin(), expected.end());
+      std::sort(actual.begin(), actual.end());
+      REQUIRE(actual == expected);
+    }
+  }
+}
@@ -0,0 +1,128 @@
+#include "catch2/catch.hpp"
+#include "fixtures.hpp"
+#include "immutable_string/builder.hpp"
+#include "immutable_string/pmr.hpp"
+
+#include <cstddef>
+#include <memory_resource>
+#include <stdexcept>
+#include <string>
+
+using namespace immutable_string;
+
+static_assert(sizeof(pmr::string) == sizeof(void*),
+              "pmr string shall be one pointer wide");
+
+namespace {
+
+// Counts the allocations passed on to another resource.
+class counting_resource : public std::pmr::memory_resource {
+ public:
+  explicit counting_resource(std::pmr::memory_resource* upstream) noexcept
+      : m_upstream(upstream) {}
+
+  int allocated = 0;
+  int deallocated = 0;
+
+ private:
+  void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+    ++allocated;
+    return m_upstream->allocate(bytes, alignment);
+  }
+  void do_deallocate(void* p, std::size_t bytes,
+                     std::size_t alignment) override {
+    ++deallocated;
+    m_upstream->deallocate(p, bytes, alignment);
+  }
+  bool do_is_equal(const memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+
+  std::pmr::memory_resource* m_upstream;
+};
+
+}  // namespace
+
+SCENARIO("pmr strings allocate from their memory resource", "[pmr]") {
+  GIVEN("two resources of one string type") {
+    counting_resource first(std::pmr::new_delete_resource());
+    counting_resource second(std::pmr::new_delete_resource());
+
+    WHEN("strings are made from each") {
+      {
+        const pmr::string str1{long_cstr, &first};
+        const pmr::string str2{long_cstr, &second};
+        const pmr::string copy = str1;
+        const pmr::string slice = str2.substr(2);
+        const pmr::string short_str{"abc", &first};
+
+        REQUIRE(str1 == str2);
+        REQUIRE(copy.data() == str1.data());
+        REQUIRE(std::string(slice.c_str()) == long_cstr + 2);
+        REQUIRE(short_str == "abc");
+        REQUIRE(first.allocated == 1);
+        REQUIRE(second.allocated == 2);
+      }
+
+      THEN("each gets its memory back") {
+        REQUIRE(first.deallocated == 1);
+        REQUIRE(second.deallocated == 2);
+      }
+    }
+  }
+
+  GIVEN("monotonic buffer") {
+    char buffer[1024];
+    std::pmr::monotonic_buffer_resource buffer_resource(
+        buffer, sizeof(buffer), std::pmr::null_memory_resource());
+
+    THEN("strings are placed in it") {
+      const pmr::string str{long_cstr, &buffer_resource};
+      REQUIRE(str.data() >= buffer);
+      REQUIRE(str.data() < buffer + sizeof(buffer));
+    }
+  }
+
+  GIVEN("default resource") {
+    const pmr::wstring str{L"a wide string too long to be stored inline"};
+
+    THEN("it is used") {
+      REQUIRE(str.size() == 42);
+      REQUIRE(str.find(L"wide") == 2);
+    }
+  }
+}
+
+SCENARIO("pmr strings are concatenated in their memory resource", "[pmr]") {
+  GIVEN("string of a resource") {
+    counting_resource resource(std::pmr::new_delete_resource());
+    counting_resource other(std::pmr::new_delete_resource());
+    const pmr::string str{long_cstr, &resource};
+    const pmr::string short_str{"abc", &other};
+
+    THEN("the result takes the resource of the first string") {
+      const pmr::string joined = concat(str, '/', short_str);
+      const pmr::string chain = '/' + str + short_str;
+      REQUIRE(joined.size() == chain.size());
+      REQUIRE(resource.allocated == 3);
+      REQUIRE(other.allocated == 0);
+    }
+    THEN("or the resource of a later string") {
+      const pmr::string key{"k", &other};
+      const pmr::string joined = concat(key, '/', str);
+      const pmr::string chain = key + "/" + str;
+      REQUIRE(joined == chain);
+      REQUIRE(chain.get_allocator().resource() == &resource);
+      REQUIRE(resource.allocated == 3);
+      REQUIRE(other.allocated == 0);
+      REQUIRE_THROWS_AS(concat(key, '/', short_str), std::invalid_argument);
+    }
+    THEN("or the resource given") {
+      const auto joined = concat(std::allocator_arg,
+                                 std::pmr::polymorphic_allocator<char>(&other),
+                                 short_str, str);
+      REQUIRE(joined.size() == str.size() + 3);
+      REQUIRE(other.allocated == 1);
+    }
+  }
+}
@@ -0,0 +1,82 @@
+#include "catch2/catch.hpp"
+#include "fixtures.hpp"
+#include "immutable_string/pool_allocator.hpp"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace immutable_string;
+
+static_assert(sizeof(pooled_string) == sizeof(void*),
+              "pooled string shall be one pointer wide");
+
+SCENARIO("buffer pool reuses freed blocks", "[pool]") {
+  GIVEN("block of a size class") {
+    const auto block = buffer_pool::allocate(40);
+
+    WHEN("it is freed and a block of the same class is allocated") {
+      buffer_pool::deallocate(block, 40);
+      const auto before = buffer_pool::stats();
+      const auto again = buffer_pool::allocate(48);
+
+      THEN("the thread gets it back from its own list") {
+        REQUIRE(again == block);
+        const auto after = buffer_pool::stats();
+        REQUIRE(after.allocations == before.allocations + 1);
+        REQUIRE(after.hits == before.hits + 1);
+        buffer_pool::deallocate(again, 48);
+      }
+    }
+  }
+
+  GIVEN("blocks larger than the largest class") {
+    const auto before = buffer_pool::stats();
+    const auto block = buffer_pool::allocate(buffer_pool::max_size + 1);
+    buffer_pool::deallocate(block, buffer_pool::max_size + 1);
+
+    THEN("they are passed on") {
+      REQUIRE(buffer_pool::stats().large == before.large + 1);
+    }
+  }
+}
+
+SCENARIO("pooled strings allocate from the pool", "[pool]") {
+  GIVEN("many short-lived strings") {
+    buffer_pool::flush();
+    const auto before = buffer_pool::stats();
+    for (int i = 0; i < 1000; ++i) {
+      const pooled_string str{long_cstr};
+      const pooled_string slice = str.substr(1);
+      REQUIRE(std::string(slice.c_str()) == long_cstr + 1);
+    }
+
+    THEN("almost all of them hit the free lists of the thread") {
+      const auto after = buffer_pool::stats();
+      const auto allocations = after.allocations - before.allocations;
+      const auto hits = after.hits - before.hits;
+      REQUIRE(allocations == 2000);
+      REQUIRE(hits >= 1990);
+    }
+  }
+
+  GIVEN("strings freed by another thread") {
+    std::vector<pooled_string> strings;
+    for (int i = 0; i < 1000; ++i) {
+      strings.emplace_back((std::to_string(i) + long_cstr).c_str());
+    }
+    std::thread([&strings] { strings.clear(); }).join();
+
+    THEN("their blocks come back in batches") {
+      buffer_pool::flush();
+      const auto before = buffer_pool::stats();
+      for (int i = 0; i < 1000; ++i) {
+        strings.emplace_back((std::to_string(i) + long_cstr).c_str());
+      }
+      const auto after = buffer_pool::stats();
+      REQUIRE(after.slabs == before.slabs);
+      REQUIRE(after.refills - before.refills < 100);
+      REQUIRE(strings[999] == (std::to_string(999) + long_cstr).c_str());
+    }
+  }
+}
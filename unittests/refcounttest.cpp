@@ -0,0 +1,213 @@
+#include "allocator_with_count.hpp"
+#include "catch2/catch.hpp"
+#include "fixtures.hpp"
+#include "immutable_string/string.hpp"
+
+#include <atomic>
+#include <cstring>
+#include <future>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+using namespace immutable_string;
+
+template <class RefCount>
+using string_with = basic_string<char, std::char_traits<char>,
+                                 allocator_with_count<char>, RefCount>;
+
+static_assert(string::is_thread_safe, "default string shall be thread-safe");
+static_assert(!string_with<nonatomic_refcount>::is_thread_safe,
+              "non-atomic string shall not be thread-safe");
+static_assert(string_with<biased_refcount>::is_thread_safe,
+              "biased string shall be thread-safe");
+static_assert(string_with<deferred_refcount>::is_thread_safe,
+              "deferred string shall be thread-safe");
+static_assert(!deferred_refcount::has_exact_use_count,
+              "deferred use_count() misses other threads' counts");
+static_assert(sizeof(string_with<nonatomic_refcount>) == sizeof(void*),
+              "refcount policy shall not change the string size");
+static_assert(
+    std::is_nothrow_copy_constructible<string_with<biased_refcount>>::value,
+    "string shall be nothrow copy-constructible with any policy");
+
+template <class RefCount>
+static void require_shared_copies() {
+  int allocated_count = 0;
+  auto allocator = allocator_with_count<char>{allocated_count};
+  string_with<RefCount> str{long_cstr, allocator};
+
+  REQUIRE(str.use_count() == 1);
+  {
+    string_with<RefCount> copy1{str};
+    string_with<RefCount> copy2{allocator};
+    copy2 = copy1;
+
+    REQUIRE(copy2.data() == str.data());
+    REQUIRE(str.use_count() == 3);
+  }
+  REQUIRE(str.use_count() == 1);
+  REQUIRE(allocated_count == 1);
+  REQUIRE(std::strcmp(str.c_str(), long_cstr) == 0);
+}
+
+SCENARIO("copies share one buffer with every refcount policy",
+         "[refcount]") {
+  GIVEN("atomic refcount") { require_shared_copies<atomic_refcount>(); }
+  GIVEN("non-atomic refcount") { require_shared_copies<nonatomic_refcount>(); }
+  GIVEN("biased refcount") { require_shared_copies<biased_refcount>(); }
+  GIVEN("deferred refcount") {
+    require_shared_copies<deferred_refcount>();
+    deferred_refcount::flush();
+  }
+}
+
+SCENARIO("biased strings are shared between threads", "[refcount]") {
+  using biased_string = basic_string<char, std::char_traits<char>,
+                                     std::allocator<char>, biased_refcount>;
+
+  GIVEN("string copied and released by other threads") {
+    biased_string str{long_cstr};
+    std::atomic<int> mismatches{0};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+      threads.emplace_back([&str, &mismatches] {
+        for (int j = 0; j < 1000; ++j) {
+          biased_string copy{str};
+          if (copy.data() != str.data()) ++mismatches;
+        }
+      });
+    }
+    for (auto& thread : threads) thread.join();
+
+    REQUIRE(mismatches == 0);
+    REQUIRE(str.use_count() == 1);
+  }
+  GIVEN("string which outlives its owner thread") {
+    biased_string str;
+    std::thread([&str] { str = biased_string{long_cstr}; }).join();
+
+    biased_string copy{str};
+    REQUIRE(str.use_count() == 2);
+    REQUIRE(std::strcmp(copy.c_str(), long_cstr) == 0);
+  }
+  GIVEN("owner's reference released by another thread") {
+    biased_string str{long_cstr};
+    biased_string copy{str};
+    std::thread([&copy] { copy = biased_string{}; }).join();
+
+    REQUIRE(str.use_count() == 1);
+    biased_refcount::collect();
+    REQUIRE(str.use_count() == 1);
+    REQUIRE(std::strcmp(str.c_str(), long_cstr) == 0);
+  }
+  GIVEN("strings released by other threads while their owner exits") {
+    const int count = 1000;
+    static std::atomic<int> deleted{0};
+    static std::atomic<bool> exiting{false};
+    // made after the thread state, so destroyed right before it
+    struct signal_at_exit {
+      ~signal_at_exit() { exiting = true; }
+    };
+    for (int i = 0; i < count; ++i) {
+      biased_string str;
+      exiting = false;
+      std::thread owner([&str] {
+        const auto deleter = [](const char*) { ++deleted; };
+        str = biased_string{adopt, long_cstr, std::strlen(long_cstr), deleter};
+        static thread_local signal_at_exit signal;
+        (void)signal;
+      });
+      std::thread releaser([&str] {
+        while (!exiting) std::this_thread::yield();
+        str = biased_string{};
+      });
+      owner.join();
+      releaser.join();
+    }
+
+    THEN("every one is freed") { REQUIRE(deleted == count); }
+  }
+  GIVEN("strings destroyed after the state of their owner thread") {
+    static std::atomic<int> deleted{0};
+    std::thread([] {
+      // made before the thread state, so destroyed after it
+      static thread_local biased_string owned;
+      static thread_local biased_string made_late;
+      struct make_at_exit {
+        ~make_at_exit() {
+          made_late = biased_string{long_cstr};
+          biased_string copy{made_late};
+        }
+      };
+      static thread_local make_at_exit maker;
+      const auto deleter = [](const char*) { ++deleted; };
+      owned = biased_string{adopt, long_cstr, std::strlen(long_cstr), deleter};
+      biased_string copy{owned};
+      (void)maker;
+    }).join();
+
+    THEN("they are freed") { REQUIRE(deleted == 1); }
+  }
+}
+
+SCENARIO("deferred strings are shared between threads", "[refcount]") {
+  using deferred_string = basic_string<char, std::char_traits<char>,
+                                       std::allocator<char>, deferred_refcount>;
+  const auto size = std::strlen(long_cstr);
+  std::atomic<bool> deleted{false};
+  auto deleter = [&deleted](const char*) { deleted = true; };
+
+  GIVEN("string copied and released by other threads") {
+    deferred_string str{adopt, long_cstr, size, deleter};
+    std::atomic<int> mismatches{0};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+      threads.emplace_back([&str, &mismatches] {
+        for (int j = 0; j < 1000; ++j) {
+          deferred_string copy{str};
+          if (copy.data() != str.data()) ++mismatches;
+        }
+      });
+    }
+    for (auto& thread : threads) thread.join();
+
+    REQUIRE(mismatches == 0);
+    REQUIRE(str.use_count() == 1);
+    str = deferred_string{};
+    REQUIRE(deleted);
+  }
+  GIVEN("copies made by one thread and released by another") {
+    deferred_string str{adopt, long_cstr, size, deleter};
+    std::vector<deferred_string> copies;
+    std::thread([&str, &copies] {
+      for (int i = 0; i < 100; ++i) copies.push_back(str);
+    }).join();
+
+    REQUIRE(str.use_count() == 101);
+    copies.clear();
+    REQUIRE(str.use_count() == 1);
+    str = deferred_string{};
+    REQUIRE(deleted);
+  }
+  GIVEN("last reference dropped while another thread holds a count") {
+    deferred_string str{adopt, long_cstr, size, deleter};
+    std::promise<void> copied;
+    std::promise<void> dropped;
+    std::thread thread([&str, &copied, &dropped] {
+      { deferred_string copy{str}; }
+      copied.set_value();
+      dropped.get_future().wait();
+      deferred_refcount::flush();
+    });
+
+    copied.get_future().wait();
+    str = deferred_string{};
+    const bool deleted_before_flush = deleted;
+    dropped.set_value();
+    thread.join();
+
+    REQUIRE_FALSE(deleted_before_flush);
+    REQUIRE(deleted);
+  }
+}
@@ -0,0 +1,182 @@
+#include "catch2/catch.hpp"
+#include "immutable_string/rope.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+using namespace immutable_string;
+
+namespace {
+
+// Text of `count` characters with a period long enough to cross chunks.
+std::string make_text(std::size_t count) {
+  std::string text;
+  for (std::size_t i = 0; text.size() < count; ++i) {
+    text += "line " + std::to_string(i) + ";";
+  }
+  text.resize(count);
+  return text;
+}
+
+std::string flatten(const rope& r) {
+  std::string result;
+  r.for_each_chunk([&result](const char* data, std::size_t count) {
+    result.append(data, count);
+  });
+  return result;
+}
+
+}  // namespace
+
+SCENARIO("rope shares chunks between versions", "[rope]") {
+  GIVEN("rope of a large string") {
+    const auto text = make_text(100000);
+    const string str{text.data(), text.size()};
+    const rope document{str};
+
+    THEN("it references the string") {
+      REQUIRE(document.size() == text.size());
+      REQUIRE(&document[0] == str.data());
+      REQUIRE(document.str().data() == str.data());
+      REQUIRE(document == str);
+    }
+    THEN("its slices reference the string too") {
+      const auto middle = document.substr(1000, 50000);
+      REQUIRE(&middle[0] == str.data() + 1000);
+      REQUIRE(middle.size() == 50000);
+      REQUIRE(middle.str() == string{text.data() + 1000, 50000});
+    }
+    THEN("edited versions keep the unchanged characters in place") {
+      const auto edited = document.replace(50000, 10, rope{"[edited]"});
+      REQUIRE(edited.size() == text.size() - 2);
+      REQUIRE(&edited[0] == str.data());
+      REQUIRE(&edited[60000] == str.data() + 60002);
+      REQUIRE(flatten(edited) ==
+              std::string(text).replace(50000, 10, "[edited]"));
+      REQUIRE(document == str);
+    }
+    THEN("positions past the end throw") {
+      REQUIRE_THROWS_AS(document.at(text.size()), std::out_of_range);
+      REQUIRE_THROWS_AS(document.substr(text.size() + 1), std::out_of_range);
+      REQUIRE(document.substr(text.size()).empty());
+    }
+  }
+
+  GIVEN("rope built from many small pieces") {
+    rope r;
+    std::string expected;
+    for (int i = 0; i < 10000; ++i) {
+      const auto piece = std::to_string(i) + ",";
+      r = r + rope{piece.c_str()};
+      expected += piece;
+    }
+
+    THEN("small chunks are merged") {
+      std::size_t chunks = 0;
+      r.for_each_chunk([&chunks](const char*, std::size_t) { ++chunks; });
+      REQUIRE(chunks <= expected.size() / (rope::merge_size / 2));
+      REQUIRE(flatten(r) == expected);
+    }
+    THEN("it is indexed like the string") {
+      for (std::size_t i = 0; i < expected.size(); i += 97) {
+        REQUIRE(r[i] == expected[i]);
+      }
+    }
+    THEN("needles longer than a chunk are found across several") {
+      for (std::size_t pos = 0; pos + 500 < expected.size(); pos += 1009) {
+        const auto needle = expected.substr(pos, 300 + pos % 200);
+        REQUIRE(r.find(needle.c_str(), pos / 2, needle.size()) == pos);
+        REQUIRE(r.find(needle.c_str(), pos + 1, needle.size()) == rope::npos);
+      }
+    }
+    THEN("comparison stops at the first difference") {
+      const auto changed = r.replace(expected.size() - 2, 1, rope{"x"});
+      REQUIRE(r.compare(changed) < 0);
+      REQUIRE(changed.compare(r) > 0);
+      REQUIRE(r.substr(2).compare(r) > 0);
+    }
+  }
+}
+
+SCENARIO("rope edits match string edits", "[rope]") {
+  GIVEN("random inserts and erases") {
+    const auto text = make_text(5000);
+    rope r{text.c_str()};
+    std::string expected = text;
+    std::uint32_t seed = 12345;
+    auto next = [&seed](std::size_t bound) {
+      seed = seed * 1103515245 + 12345;
+      return static_cast<std::size_t>(seed >> 8) % bound;
+    };
+
+    for (int i = 0; i < 2000; ++i) {
+      const auto pos = next(expected.size() + 1);
+      if (next(3) == 0) {
+        const auto count = next(300);
+        r = r.erase(pos, count);
+        expected.erase(pos, count);
+      } else {
+        const auto from = next(text.size());
+        const auto count = next(text.size() - from) % 200;
+        r = r.insert(pos, rope{text.c_str()}.substr(from, count));
+        expected.insert(pos, text, from, count);
+      }
+    }
+
+    THEN("the characters are the same") {
+      REQUIRE(r.size() == expected.size());
+      REQUIRE(flatten(r) == expected);
+      REQUIRE(r.str() == string{expected.data(), expected.size()});
+      for (std::size_t i = 0; i < expected.size(); i += 31) {
+        REQUIRE(r[i] == expected[i]);
+      }
+    }
+    THEN("find crosses chunk boundaries") {
+      for (std::size_t pos = 0; pos + 40 < expected.size(); pos += 211) {
+        for (const std::size_t count : {1, 2, 7, 40}) {
+          const auto needle = expected.substr(pos, count);
+          REQUIRE(r.find(needle.c_str(), 0, count) ==
+                  expected.find(needle.c_str(), 0, count));
+          REQUIRE(r.find(needle.c_str(), pos / 2, count) ==
+                  expected.find(needle.c_str(), pos / 2, count));
+        }
+        REQUIRE(r.find(expected[pos], pos / 3) ==
+                expected.find(expected[pos], pos / 3));
+      }
+      REQUIRE(r.find("no such line") == rope::npos);
+      REQUIRE(r.find("", 3) == 3);
+    }
+  }
+}
+
+SCENARIO("rope comparison", "[rope]") {
+  GIVEN("ropes with different chunks") {
+    const rope whole{"a string too long to be stored inline"};
+    const auto pieces = rope{"a string "} + rope{"too long to be "} +
+                        rope{"stored inline"};
+    const auto other = whole.replace(2, 6, rope{"rope"});
+
+    THEN("they compare by characters") {
+      REQUIRE(whole == pieces);
+      REQUIRE(whole != other);
+      REQUIRE(pieces.compare(other) > 0);
+      REQUIRE(other < whole);
+      REQUIRE(whole.substr(0, 5) < whole);
+      REQUIRE(whole <= pieces);
+      REQUIRE(whole >= pieces);
+      REQUIRE(rope{} < whole);
+      REQUIRE(rope{} == rope{""});
+    }
+    THEN("they compare with strings") {
+      REQUIRE(pieces == "a string too long to be stored inline");
+      REQUIRE(pieces == string{"a string too long to be stored inline"});
+      REQUIRE(pieces.compare("a string too long") > 0);
+      REQUIRE(pieces.compare("a string too long to be stored inline!") < 0);
+      REQUIRE(pieces.compare("a string two") < 0);
+      REQUIRE(string{"a rope too long to be stored inline"} == other);
+      REQUIRE(rope{}.compare("") == 0);
+    }
+  }
+}
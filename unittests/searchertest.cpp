@@ -0,0 +1,118 @@
+#include "catch2/catch.hpp"
+#include "immutable_string/searcher.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+using namespace immutable_string;
+
+SCENARIO("searcher finds its needle in many strings", "[searcher]") {
+  GIVEN("short needle") {
+    const searcher needle{string{"cddd"}};
+    REQUIRE(needle.needle() == "cddd");
+
+    THEN("it is found in every string containing it") {
+      REQUIRE(string{"aaabbbcccddd"}.find(needle) == 8);
+      REQUIRE(string{"cddd"}.find(needle) == 0);
+      REQUIRE(string{"cdddcddd"}.find(needle, 1) == 4);
+      REQUIRE(string{"cdd"}.find(needle) == string::npos);
+      REQUIRE(string{"aaabbbcccddd"}.find(needle, 13) == string::npos);
+    }
+  }
+
+  GIVEN("long needle") {
+    const std::string text = std::string(1000, 'a') + "b" +
+                             std::string(1000, 'a') + "c";
+    const std::string pattern = std::string(100, 'a') + "c";
+    const searcher needle{string{pattern.c_str()}};
+
+    THEN("it is found with the same result as std::string::find") {
+      const string haystack{text.c_str()};
+      REQUIRE(haystack.find(needle) == text.find(pattern));
+      REQUIRE(haystack.find(needle, 1901) == text.find(pattern, 1901));
+      REQUIRE(haystack.find(needle, 1902) == string::npos);
+      REQUIRE(string{pattern.c_str()}.find(needle) == 0);
+    }
+  }
+
+  GIVEN("needle the vectorized search gives up on") {
+    const std::string pattern =
+        std::string(100, 'a') + "b" + std::string(100, 'a');
+    const std::string text =
+        std::string(3000, 'a') + "b" + std::string(3000, 'a');
+    const searcher needle{string{pattern.c_str()}};
+
+    THEN("the rest is searched with its factorization") {
+      const string haystack{text.c_str()};
+      for (const std::size_t pos : {0, 1000, 2900, 2901}) {
+        REQUIRE(haystack.find(needle, pos) == text.find(pattern, pos));
+        REQUIRE(haystack.find(needle, pos) ==
+                haystack.find(pattern.c_str(), pos));
+      }
+    }
+  }
+
+  GIVEN("empty needle") {
+    const searcher needle{string{}};
+
+    THEN("it is found at the starting position") {
+      REQUIRE(string{"abc"}.find(needle) == 0);
+      REQUIRE(string{"abc"}.find(needle, 3) == 3);
+      REQUIRE(string{"abc"}.find(needle, 4) == string::npos);
+      REQUIRE(string{}.find(needle) == 0);
+    }
+  }
+
+  GIVEN("wide needles") {
+    const wsearcher short_needle{wstring{L"wide"}};
+    const wsearcher long_needle{
+        wstring{L"some wide characters, enough for Two-Way"}};
+    const wstring text{
+        L"and here are some wide characters, enough for Two-Way"};
+
+    THEN("they are searched with the character traits") {
+      REQUIRE(text.find(short_needle) == 18);
+      REQUIRE(text.find(long_needle) == 13);
+      REQUIRE(text.find(long_needle, 14) == wstring::npos);
+    }
+  }
+}
+
+SCENARIO("searcher matches iterator ranges", "[searcher]") {
+  GIVEN("searcher and a few containers") {
+    const searcher needle{string{"needle"}};
+    const std::string text = "haystack with a needle in it";
+    const std::vector<char> chars(text.begin(), text.end());
+    const string str{text.c_str()};
+
+    THEN("it returns the range of the match") {
+      const auto in_text = needle(text.begin(), text.end());
+      REQUIRE(in_text.first - text.begin() == 16);
+      REQUIRE(in_text.second - text.begin() == 22);
+
+      const auto in_chars = needle(chars.begin(), chars.end());
+      REQUIRE(in_chars.first - chars.begin() == 16);
+
+      const auto in_str = needle(str.begin(), str.end());
+      REQUIRE(in_str.first == str.begin() + 16);
+    }
+
+    THEN("it returns an empty range at the end without a match") {
+      const auto in_prefix = needle(text.begin(), text.begin() + 20);
+      REQUIRE(in_prefix.first == text.begin() + 20);
+      REQUIRE(in_prefix.second == text.begin() + 20);
+
+      const auto in_empty = needle(text.end(), text.end());
+      REQUIRE(in_empty.first == text.end());
+    }
+
+#if __cplusplus >= 201703L
+    THEN("it plugs into std::search") {
+      REQUIRE(std::search(text.begin(), text.end(), needle) ==
+              text.begin() + 16);
+    }
+#endif
+  }
+}
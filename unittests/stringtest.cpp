@@ -1,15 +1,23 @@
 #include "allocator_with_count.hpp"
 #include "catch2/catch.hpp"
+#include "fixtures.hpp"
 #include "immutable_string/string.hpp"
 
 #include <cstring>
+#include <cwchar>
+#include <memory>
 #include <type_traits>
+#include <unordered_set>
 
 using namespace immutable_string;
 
 using string_count_alloc =
     basic_string<char, std::char_traits<char>, allocator_with_count<char>>;
 
+static_assert(sizeof(string) == sizeof(void*),
+              "string shall be one pointer wide");
+static_assert(std::is_nothrow_default_constructible<string>::value,
+              "string shall be nothrow default-constructible");
 static_assert(std::is_nothrow_copy_constructible<string>::value,
               "string shall be nothrow copy-constructible");
 static_assert(std::is_nothrow_copy_assignable<string>::value,
@@ -42,6 +50,26 @@ SCENARIO("empty string construction", "[string]") {
     string str{0, '1'};
     REQUIRE_EMPTY(str);
   }
+  GIVEN("strings constructed with allocator with count") {
+    int allocated_count = 0;
+    auto allocator = allocator_with_count<char>{allocated_count};
+    string_count_alloc str1{allocator};
+    string_count_alloc str2{"", allocator};
+    string_count_alloc str3{long_cstr, 0, allocator};
+
+    REQUIRE_EMPTY(str1);
+    REQUIRE_EMPTY(str2);
+    REQUIRE_EMPTY(str3);
+    REQUIRE(allocated_count == 0);
+
+    WHEN("heap string is cleared by assignment") {
+      string_count_alloc str{long_cstr, allocator};
+      str = string_count_alloc{allocator};
+
+      THEN("it is empty") { REQUIRE_EMPTY(str); }
+      THEN("nothing else is allocated") { REQUIRE(allocated_count == 1); }
+    }
+  }
 }
 
 SCENARIO("non-empty string construction", "[string]") {
@@ -63,13 +91,25 @@ SCENARIO("non-empty string construction", "[string]") {
     REQUIRE(str.size() == 5);
     REQUIRE(std::strcmp(str.c_str(), "11111") == 0);
   }
+  GIVEN("wide strings of different lengths") {
+    wstring empty_str{L""};
+    wstring short_str{L"t"};
+    wstring long_str{L"wide test"};
+
+    REQUIRE(empty_str.empty());
+    REQUIRE(std::wcscmp(empty_str.c_str(), L"") == 0);
+    REQUIRE(short_str.size() == 1);
+    REQUIRE(std::wcscmp(short_str.c_str(), L"t") == 0);
+    REQUIRE(long_str.size() == 9);
+    REQUIRE(std::wcscmp(long_str.c_str(), L"wide test") == 0);
+  }
 }
 
 SCENARIO("string is copyable without new allocations", "[string]") {
   GIVEN("some test string constructed with allocator with count") {
     int allocated_count = 0;
     auto allocator = allocator_with_count<char>{allocated_count};
-    string_count_alloc test_str{"test", allocator};
+    string_count_alloc test_str{long_cstr, allocator};
 
     REQUIRE(allocated_count == 1);
 
@@ -86,7 +126,7 @@ SCENARIO("string is copyable without new allocations", "[string]") {
     }
     WHEN("new string is created and test string is assigned to it") {
       string_count_alloc new_str{allocator};
-      REQUIRE(allocated_count == 2);
+      REQUIRE(allocated_count == 1);
 
       new_str = test_str;
 
@@ -96,7 +136,7 @@ SCENARIO("string is copyable without new allocations", "[string]") {
       THEN("they have the same size") {
         REQUIRE(test_str.size() == new_str.size());
       }
-      THEN("allocated count is 2") { REQUIRE(allocated_count == 2); }
+      THEN("allocated count is 1") { REQUIRE(allocated_count == 1); }
     }
   }
 }
@@ -105,34 +145,72 @@ SCENARIO("string is movable", "[string]") {
   GIVEN("some test string") {
     int allocated_count = 0;
     auto allocator = allocator_with_count<char>{allocated_count};
-    string_count_alloc test_str{"test", allocator};
+    string_count_alloc test_str{long_cstr, allocator};
 
     WHEN("new string is move-constructed") {
       string_count_alloc new_str{std::move(test_str)};
 
       THEN("new string has test string") {
-        REQUIRE(std::strcmp(new_str.data(), "test") == 0);
-      }
-      THEN("test string is unusable and point to nullptr") {
-        REQUIRE(test_str.data() == nullptr);
+        REQUIRE(std::strcmp(new_str.data(), long_cstr) == 0);
       }
+      THEN("test string is empty") { REQUIRE_EMPTY(test_str); }
       THEN("allocated count is 1") { REQUIRE(allocated_count == 1); }
     }
     WHEN("new string is creeated and test string is move-assigned to it") {
       string_count_alloc new_str{allocator};
-      REQUIRE(allocated_count == 2);
+      REQUIRE(allocated_count == 1);
 
       new_str = std::move(test_str);
 
       THEN("new string has test string") {
-        REQUIRE(std::strcmp(new_str.data(), "test") == 0);
+        REQUIRE(std::strcmp(new_str.data(), long_cstr) == 0);
       }
-      THEN("test string is unusable and point to nullptr") {
-        REQUIRE(test_str.data() == nullptr);
+      THEN("test string is empty") { REQUIRE_EMPTY(test_str); }
+      THEN("allocated count is 1") { REQUIRE(allocated_count == 1); }
+    }
+  }
+}
+
+SCENARIO("short strings are stored inline", "[string]") {
+  int allocated_count = 0;
+  auto allocator = allocator_with_count<char>{allocated_count};
+
+  GIVEN("strings up to the inline capacity") {
+    string_count_alloc empty_str{allocator};
+    string_count_alloc short_str{"tag", allocator};
+    string_count_alloc full_str{sizeof(void*) - 2, 'x', allocator};
+
+    THEN("nothing is allocated") { REQUIRE(allocated_count == 0); }
+    THEN("they keep their contents") {
+      REQUIRE(std::strcmp(short_str.c_str(), "tag") == 0);
+      REQUIRE(full_str.size() == sizeof(void*) - 2);
+      REQUIRE(full_str[full_str.size()] == 0);
+    }
+    WHEN("short string is copied") {
+      string_count_alloc new_str{short_str};
+
+      THEN("copy owns its own characters") {
+        REQUIRE(new_str.data() != short_str.data());
+        REQUIRE(new_str == short_str);
+      }
+      THEN("nothing is allocated") { REQUIRE(allocated_count == 0); }
+    }
+    WHEN("short string is assigned over a heap string") {
+      string_count_alloc new_str{long_cstr, allocator};
+      new_str = short_str;
+
+      THEN("it holds the short string") {
+        REQUIRE(std::strcmp(new_str.c_str(), "tag") == 0);
+        REQUIRE(new_str.size() == 3);
       }
-      THEN("allocated count is 2") { REQUIRE(allocated_count == 2); }
     }
   }
+  GIVEN("string just above the inline capacity") {
+    string_count_alloc str{sizeof(void*) - 1, 'x', allocator};
+
+    THEN("it is allocated on the heap") { REQUIRE(allocated_count == 1); }
+    THEN("size is kept") { REQUIRE(str.size() == sizeof(void*) - 1); }
+  }
 }
 
 SCENARIO("string's element access", "[string]") {
@@ -227,6 +305,43 @@ SCENARIO("string comparison") {
   }
 }
 
+SCENARIO("string equality shortcuts", "[string]") {
+  using counted_string = basic_string<char, counting_traits>;
+
+  GIVEN("copies and substrings sharing the characters") {
+    const counted_string str{long_cstr};
+    const counted_string copy = str;
+    const counted_string slice1 = str.substr(2, 20);
+    const counted_string slice2 = str.substr(2, 20);
+
+    WHEN("they are compared") {
+      counting_traits::comparisons() = 0;
+
+      THEN("characters are not compared") {
+        REQUIRE(str == copy);
+        REQUIRE(slice1 == slice2);
+        REQUIRE(counting_traits::comparisons() == 0);
+      }
+    }
+  }
+
+  GIVEN("strings with their hashes computed") {
+    const string str1{"a string too long to be stored inline 1"};
+    const string str2{"a string too long to be stored inline 2"};
+    const string str3{"a string too long to be stored inline 1"};
+    str1.hash();
+    str2.hash();
+    str3.hash();
+
+    THEN("equality gives the same results") {
+      REQUIRE(str1 != str2);
+      REQUIRE(str1 == str3);
+      REQUIRE(str1.substr(1) == str3.substr(1));
+      REQUIRE(str1.substr(1) != str2.substr(1));
+    }
+  }
+}
+
 SCENARIO("string vs const char* comparison") {
   GIVEN("str == abcd") {
     int allocated_count = 0;
@@ -248,7 +363,7 @@ SCENARIO("string vs const char* comparison") {
     REQUIRE_FALSE("abcd" > str);
     REQUIRE_FALSE("abcd" != str);
 
-    REQUIRE(allocated_count == 1);
+    REQUIRE(allocated_count == 0);
   }
   GIVEN("str < abcde") {
     int allocated_count = 0;
@@ -270,7 +385,7 @@ SCENARIO("string vs const char* comparison") {
     REQUIRE_FALSE("abcde" <= str);
     REQUIRE_FALSE("abcde" == str);
 
-    REQUIRE(allocated_count == 1);
+    REQUIRE(allocated_count == 0);
   }
   GIVEN("str > abcc") {
     int allocated_count = 0;
@@ -292,7 +407,233 @@ SCENARIO("string vs const char* comparison") {
     REQUIRE_FALSE("abcc" >= str);
     REQUIRE_FALSE("abcc" == str);
 
+    REQUIRE(allocated_count == 0);
+  }
+}
+
+SCENARIO("substrings share the parent's characters", "[string]") {
+  int allocated_count = 0;
+  auto allocator = allocator_with_count<char>{allocated_count};
+
+  GIVEN("heap string") {
+    string_count_alloc str{long_cstr, allocator};
     REQUIRE(allocated_count == 1);
+
+    WHEN("long substring is taken") {
+      auto sub = str.substr(2, 15);
+
+      THEN("it points into the parent") {
+        REQUIRE(sub.data() == str.data() + 2);
+        REQUIRE(sub.size() == 15);
+        REQUIRE(sub == "string too long");
+      }
+      THEN("only a small header is allocated") {
+        REQUIRE(allocated_count == 2);
+      }
+      THEN("c_str returns a terminated copy") {
+        REQUIRE(std::strcmp(sub.c_str(), "string too long") == 0);
+        REQUIRE(sub.c_str() != sub.data());
+        REQUIRE(sub.c_str() == sub.c_str());
+      }
+      THEN("it survives the parent") {
+        str = string_count_alloc{allocator};
+        REQUIRE(sub == "string too long");
+      }
+      THEN("its substrings point into the parent too") {
+        auto subsub = sub.substr(7);
+        REQUIRE(subsub.data() == str.data() + 9);
+        REQUIRE(subsub == "too long");
+      }
+      THEN("compact copies it into its own buffer") {
+        auto compacted = sub.compact();
+        REQUIRE(compacted.data() != sub.data());
+        REQUIRE(compacted == sub);
+        REQUIRE(compacted.c_str() == compacted.data());
+        REQUIRE(str.use_count() == 2);
+      }
+    }
+    WHEN("suffix is taken") {
+      auto sub = str.substr(2);
+
+      THEN("c_str needs no copy") {
+        REQUIRE(sub.c_str() == sub.data());
+        REQUIRE(std::strcmp(sub.c_str(), long_cstr + 2) == 0);
+      }
+    }
+    WHEN("short substring is taken") {
+      auto sub = str.substr(2, 3);
+
+      THEN("it is stored inline") {
+        REQUIRE(sub == "str");
+        REQUIRE(allocated_count == 1);
+        REQUIRE(str.use_count() == 1);
+      }
+    }
+    WHEN("whole string is taken") {
+      auto sub = str.substr();
+
+      THEN("it is a plain copy") {
+        REQUIRE(sub.data() == str.data());
+        REQUIRE(str.use_count() == 2);
+      }
+    }
+    WHEN("substring starts past the end") {
+      THEN("substr throws") {
+        REQUIRE(str.substr(str.size()).empty());
+        REQUIRE_THROWS_AS(str.substr(str.size() + 1), std::out_of_range);
+      }
+    }
+  }
+}
+
+SCENARIO("strings adopt external buffers", "[string]") {
+  int allocated_count = 0;
+  auto allocator = allocator_with_count<char>{allocated_count};
+  int deleted_count = 0;
+  const auto deleter = [&deleted_count](const char*) { ++deleted_count; };
+  // not terminated: the adopted characters are followed by a '!'
+  const char buffer[] = "a string too long to be stored inline!";
+  const auto size = std::strlen(long_cstr);
+
+  GIVEN("unterminated buffer") {
+    auto str = string_count_alloc{adopt, buffer, size, deleter, allocator};
+
+    THEN("its characters are referenced in place") {
+      REQUIRE(str.data() == buffer);
+      REQUIRE(str == long_cstr);
+      REQUIRE(allocated_count == 1);
+    }
+    THEN("c_str returns a terminated copy") {
+      REQUIRE(str.c_str() != buffer);
+      REQUIRE(std::strcmp(str.c_str(), long_cstr) == 0);
+      REQUIRE(str.c_str() == str.c_str());
+      REQUIRE(allocated_count == 2);
+    }
+    THEN("its suffixes are not terminated either") {
+      const auto sub = str.substr(2);
+      REQUIRE(sub.data() == buffer + 2);
+      REQUIRE(std::strcmp(sub.c_str(), long_cstr + 2) == 0);
+      REQUIRE(sub.c_str() != sub.data());
+    }
+    THEN("the deleter is called once the last copy is destroyed") {
+      auto copy = str;
+      auto sub = str.substr(2, 15);
+      str = string_count_alloc{allocator};
+      copy = string_count_alloc{allocator};
+      REQUIRE(deleted_count == 0);
+      REQUIRE(sub == "string too long");
+      sub = string_count_alloc{allocator};
+      REQUIRE(deleted_count == 1);
+      REQUIRE(allocated_count == 2);
+    }
+  }
+
+  GIVEN("terminated buffer") {
+    const string str{adopt_terminated, long_cstr, size, deleter};
+
+    THEN("c_str needs no copy") {
+      REQUIRE(str.c_str() == long_cstr);
+      REQUIRE(str.substr(2).c_str() == long_cstr + 2);
+    }
+  }
+
+  GIVEN("buffer fitting inline") {
+    const string str{adopt, buffer, 3, deleter};
+
+    THEN("it is copied and released right away") {
+      REQUIRE(str == "a s");
+      REQUIRE(str.data() != buffer);
+      REQUIRE(deleted_count == 1);
+    }
+  }
+
+  GIVEN("buffer owned by a shared pointer") {
+    std::shared_ptr<const char> owner(new char[size + 1](),
+                                      std::default_delete<char[]>());
+    std::memcpy(const_cast<char*>(owner.get()), long_cstr, size);
+    const string str{adopt_terminated, owner.get(), size,
+                     [owner](const char*) {}};
+
+    THEN("the string keeps it alive") {
+      REQUIRE(owner.use_count() == 2);
+      owner.reset();
+      REQUIRE(str == long_cstr);
+    }
+  }
+}
+
+namespace {
+
+using biased_string = basic_string<char, std::char_traits<char>,
+                                   std::allocator<char>, biased_refcount>;
+
+// made by a dynamic initializer, which may run before any other in the
+// program, so the literal header shall be initialized by then
+const biased_string literal_at_init =
+    biased_string::from_literal<'c', 'o', 'n', 't', 'e', 'n', 't', '-', 't',
+                                'y', 'p', 'e'>();
+
+}  // namespace
+
+SCENARIO("string literals", "[string]") {
+  GIVEN("long literal") {
+    const auto str = string::from_literal<'c', 'o', 'n', 't', 'e', 'n', 't',
+                                          '-', 't', 'y', 'p', 'e'>();
+
+    THEN("it references static storage") {
+      REQUIRE(str == "content-type");
+      REQUIRE(str.data() == string::from_literal<'c', 'o', 'n', 't', 'e', 'n',
+                                                 't', '-', 't', 'y', 'p',
+                                                 'e'>().data());
+      REQUIRE(str.c_str() == str.data());
+      REQUIRE(str.use_count() == 0);
+    }
+    THEN("its copies are not counted") {
+      auto copy = str;
+      auto moved = std::move(copy);
+      REQUIRE(moved.data() == str.data());
+      REQUIRE(str.use_count() == 0);
+      REQUIRE(moved.hash() == string{"content-type"}.hash());
+    }
+    THEN("its substrings reference it") {
+      const auto sub = str.substr(0, 7);
+      REQUIRE(sub.data() == str.data());
+      REQUIRE(std::strcmp(sub.c_str(), "content") == 0);
+      REQUIRE(str.substr(5).c_str() == str.data() + 5);
+    }
+  }
+
+  GIVEN("literal read by a static initializer") {
+    THEN("it has its characters") {
+      REQUIRE(literal_at_init == "content-type");
+      REQUIRE(literal_at_init.use_count() == 0);
+    }
+  }
+
+  GIVEN("long literal written with the suffix") {
+    const auto str = "a string too long to be stored inline"_is;
+
+    THEN("it has the characters of the literal") {
+      REQUIRE(str == long_cstr);
+      REQUIRE(str.c_str() == str.data());
+    }
+    THEN("its substrings reference it") {
+      const auto sub = str.substr(2, 15);
+      REQUIRE(sub.data() == str.data() + 2);
+      REQUIRE(sub.use_count() == 1);
+      REQUIRE(std::strcmp(sub.c_str(), "string too long") == 0);
+      REQUIRE(sub.substr(7) == "too long");
+      REQUIRE(str.substr(2).c_str() == str.data() + 2);
+    }
+  }
+
+  GIVEN("short literals") {
+    THEN("they are stored inline") {
+      REQUIRE("GET"_is == "GET");
+      REQUIRE("GET"_is.use_count() == 1);
+      REQUIRE(""_is.empty());
+      REQUIRE(L"wide"_is == L"wide");
+    }
   }
 }
 
@@ -316,5 +657,73 @@ SCENARIO("find substring in a string") {
       REQUIRE(test_str.find('e') == string::npos);
       REQUIRE(test_str.find('a', 3) == string::npos);
     }
+
+    WHEN("position is past the matches or the end") {
+      REQUIRE(test_str.find("", 12) == 12);
+      REQUIRE(test_str.find("", 13) == string::npos);
+      REQUIRE(test_str.find("dd", 11) == string::npos);
+      REQUIRE(test_str.find('d', 12) == string::npos);
+    }
+  }
+
+  GIVEN("long string with matches far from the beginning") {
+    std::string expected(100, 'x');
+    expected += "needle";
+    expected += std::string(100, 'x');
+    expected += "needle";
+    const string test_str{expected.c_str()};
+
+    THEN("every match is found") {
+      REQUIRE(test_str.find("needle") == 100);
+      REQUIRE(test_str.find("needle", 101) == 206);
+      REQUIRE(test_str.find("needle", 207) == string::npos);
+      REQUIRE(test_str.find('n', 101) == 206);
+      REQUIRE(test_str.find("xn") == 99);
+      REQUIRE(test_str.find("needlex") == 100);
+      REQUIRE(test_str.find("needley") == string::npos);
+    }
+  }
+
+  GIVEN("wide string") {
+    const wstring test_str{L"aaabbbcccddd with some wide characters"};
+
+    THEN("it is searched with the character traits") {
+      REQUIRE(test_str.find(L"cddd") == 8);
+      REQUIRE(test_str.find(L'w') == 13);
+      REQUIRE(test_str.find(L"wide", 14) == 23);
+      REQUIRE(test_str.find(L"wider") == wstring::npos);
+    }
+  }
+}
+
+SCENARIO("string hash", "[string]") {
+  GIVEN("strings with the same characters stored differently") {
+    const string heap{long_cstr};
+    const string copy = heap;
+    const string slice = string{"prefix: a string too long to be stored inline"}
+                             .substr(8);
+    const string other{"a string too long to be stored inline!"};
+
+    THEN("their hashes are equal") {
+      REQUIRE(heap.hash() == copy.hash());
+      REQUIRE(heap.hash() == slice.hash());
+      REQUIRE(heap.hash() == heap.hash());
+      REQUIRE(heap.hash() != other.hash());
+      REQUIRE(string{"abc"}.hash() == string{"abc"}.hash());
+      REQUIRE(string{"abc"}.hash() != string{"abd"}.hash());
+      REQUIRE(string{}.hash() == string{""}.hash());
+      REQUIRE(std::hash<string>{}(heap) == heap.hash());
+      REQUIRE(wstring{L"wide"}.hash() == wstring{L"wide"}.hash());
+    }
+  }
+
+  GIVEN("unordered set of strings") {
+    std::unordered_set<string> set{string{"abc"}, string{long_cstr}};
+
+    THEN("strings are looked up by their characters") {
+      REQUIRE(set.count(string{"abc"}) == 1);
+      REQUIRE(set.count(string{long_cstr}) == 1);
+      REQUIRE(set.count(string{"abd"}) == 0);
+    }
   }
 }
@@ -0,0 +1,77 @@
+#include "catch2/catch.hpp"
+#include "fixtures.hpp"
+#include "immutable_string/symbol.hpp"
+
+#include <cstddef>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+
+using namespace immutable_string;
+
+static_assert(std::is_base_of<string, symbol>::value,
+              "symbol shall be usable as a string");
+static_assert(sizeof(symbol) == sizeof(void*),
+              "symbol shall be one pointer wide");
+
+SCENARIO("symbols with the same characters are identical", "[symbol]") {
+  GIVEN("symbols made from equal strings") {
+    const symbol first{string{long_cstr}};
+    const symbol second{long_cstr};
+    const symbol third{std::string{long_cstr}.c_str(), 37};
+    const symbol short1{"abc"};
+    const symbol short2{string{"abc"}};
+
+    THEN("they have one id") {
+      REQUIRE(first.id() == second.id());
+      REQUIRE(first.id() == third.id());
+      REQUIRE(first.data() == second.data());
+      REQUIRE(short1.id() == short2.id());
+      REQUIRE(first == second);
+      REQUIRE(short1 == short2);
+      REQUIRE(std::hash<symbol>{}(first) == std::hash<symbol>{}(second));
+    }
+
+    THEN("different symbols have different ids") {
+      const symbol other{"another string too long to be inline"};
+      REQUIRE(first != other);
+      REQUIRE(first != short1);
+      REQUIRE(short1 != symbol{"abd"});
+      REQUIRE(symbol{} == symbol{""});
+    }
+
+    THEN("they are usable as strings") {
+      const string& str = first;
+      REQUIRE(str == long_cstr);
+      REQUIRE(first.find("too long") == 9);
+      REQUIRE(first.substr(2, 6) == "string");
+      REQUIRE(first.compare(long_cstr) == 0);
+      REQUIRE(first == string{long_cstr});
+      REQUIRE(first < short1);
+    }
+  }
+}
+
+SCENARIO("symbols compare without touching characters", "[symbol]") {
+  using counted_symbol = basic_symbol<char, counting_traits>;
+
+  GIVEN("map keyed by symbols") {
+    std::unordered_map<counted_symbol, int> map;
+    map[counted_symbol{long_cstr}] = 1;
+    map[counted_symbol{"another string too long to be inline"}] = 2;
+    map[counted_symbol{"abc"}] = 3;
+    const counted_symbol key{long_cstr};
+    const counted_symbol short_key{"abc"};
+
+    WHEN("it is looked up") {
+      counting_traits::comparisons() = 0;
+
+      THEN("only ids are compared") {
+        REQUIRE(map.at(key) == 1);
+        REQUIRE(map.at(short_key) == 3);
+        REQUIRE(map.count(counted_symbol{}) == 0);
+        REQUIRE(counting_traits::comparisons() == 0);
+      }
+    }
+  }
+}